@@ -0,0 +1,213 @@
+#include "ClusteredLighting.hpp"
+#include "Parallel.hpp"
+#include "GpuAllocator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+static bool sphereTouchesBox(const glm::vec4& sphere, const glm::vec3& box_min, const glm::vec3& box_max) {
+    glm::vec3 center(sphere);
+    glm::vec3 d = glm::clamp(center, box_min, box_max) - center;
+    return glm::dot(d, d) <= sphere.w * sphere.w;
+}
+
+void ClusteredLighting::buildBounds(const glm::mat4& projection, int width, int height) {
+    bounds_projection = projection;
+    bounds_width = width;
+    bounds_height = height;
+
+    // near and far plane of a perspective projection
+    float near_plane = projection[3][2] / (projection[2][2] - 1.0f);
+    float far_plane = projection[3][2] / (projection[2][2] + 1.0f);
+    float first = std::clamp(first_slice_depth, near_plane * 1.001f, far_plane * 0.999f);
+
+    // slice 0 = [near, first], slices 1.. split [first, far] exponentially
+    slice_depth.resize(GRID_Z + 1);
+    slice_depth[0] = near_plane;
+    for (int z = 1; z <= GRID_Z; ++z) {
+        slice_depth[z] = first * std::pow(far_plane / first, static_cast<float>(z - 1) / (GRID_Z - 1));
+    }
+    // slice = log(depth) * scale + bias, below 1 for everything in front of first
+    depth_scale = (GRID_Z - 1) / std::log(far_plane / first);
+    depth_bias = 1.0f - std::log(first) * depth_scale;
+
+    // view space direction (at depth 1) through every tile corner
+    glm::mat4 inverse_projection = glm::inverse(projection);
+    std::vector<glm::vec3> corner_rays((GRID_X + 1) * (GRID_Y + 1));
+    for (int y = 0; y <= GRID_Y; ++y) {
+        for (int x = 0; x <= GRID_X; ++x) {
+            glm::vec4 p = inverse_projection * glm::vec4(-1.0f + 2.0f * x / GRID_X, -1.0f + 2.0f * y / GRID_Y, -1.0f, 1.0f);
+            glm::vec3 v = glm::vec3(p) / p.w;
+            corner_rays[y * (GRID_X + 1) + x] = v / -v.z;
+        }
+    }
+
+    const Box empty{ glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()) };
+    bounds.resize(CLUSTER_COUNT);
+    column_bounds.assign(GRID_Z * GRID_X, empty);
+    row_bounds.assign(GRID_Z * GRID_Y, empty);
+    for (int z = 0; z < GRID_Z; ++z) {
+        for (int y = 0; y < GRID_Y; ++y) {
+            for (int x = 0; x < GRID_X; ++x) {
+                Box box = empty;
+                for (int corner = 0; corner < 4; ++corner) {
+                    const glm::vec3& ray = corner_rays[(y + (corner >> 1)) * (GRID_X + 1) + x + (corner & 1)];
+                    for (float depth : { slice_depth[z], slice_depth[z + 1] }) {
+                        box.min = glm::min(box.min, ray * depth);
+                        box.max = glm::max(box.max, ray * depth);
+                    }
+                }
+                bounds[(z * GRID_Y + y) * GRID_X + x] = box;
+                for (Box* part : { &column_bounds[z * GRID_X + x], &row_bounds[z * GRID_Y + y] }) {
+                    part->min = glm::min(part->min, box.min);
+                    part->max = glm::max(part->max, box.max);
+                }
+            }
+        }
+    }
+}
+
+// Tests the lights touching slice z against its columns and rows first, then only the clusters in both
+void ClusteredLighting::collectHits(int z, const std::vector<glm::vec4>& spheres, std::vector<Hit>& hits, GLuint* counts) const {
+    static_assert(GRID_X <= 32 && GRID_Y <= 32, "column and row masks are 32 bit");
+    float slice_near = slice_depth[z];
+    float slice_far = slice_depth[z + 1];
+    const Box* slice_bounds = &bounds[z * GRID_X * GRID_Y];
+
+    for (size_t i = 0; i < spheres.size(); ++i) {
+        const glm::vec4& sphere = spheres[i];
+        float depth = -sphere.z;
+        if (depth + sphere.w < slice_near || depth - sphere.w > slice_far) continue;
+
+        uint32_t columns = 0, rows = 0;
+        for (int x = 0; x < GRID_X; ++x) {
+            const Box& box = column_bounds[z * GRID_X + x];
+            if (sphereTouchesBox(sphere, box.min, box.max)) columns |= 1u << x;
+        }
+        if (columns == 0) continue;
+        for (int y = 0; y < GRID_Y; ++y) {
+            const Box& box = row_bounds[z * GRID_Y + y];
+            if (sphereTouchesBox(sphere, box.min, box.max)) rows |= 1u << y;
+        }
+
+        for (int y = 0; y < GRID_Y; ++y) {
+            if (!(rows & (1u << y))) continue;
+            for (int x = 0; x < GRID_X; ++x) {
+                if (!(columns & (1u << x))) continue;
+                GLuint c = y * GRID_X + x;
+                if (sphereTouchesBox(sphere, slice_bounds[c].min, slice_bounds[c].max)) {
+                    hits.push_back({ c, static_cast<GLuint>(i) });
+                    counts[c]++;
+                }
+            }
+        }
+    }
+}
+
+void ClusteredLighting::assignSlice(int z) {
+    constexpr int SLICE_CLUSTERS = GRID_X * GRID_Y;
+    GLuint point_counts[SLICE_CLUSTERS] = {};
+    GLuint spot_counts[SLICE_CLUSTERS] = {};
+    std::vector<Hit>& hits = slice_hits[z];
+    hits.clear();
+    collectHits(z, point_spheres, hits, point_counts);
+    size_t point_hits = hits.size();
+    collectHits(z, spot_spheres, hits, spot_counts);
+
+    // per cluster: point light indices, then spot light indices (counting sort of the hits)
+    GLuint point_cursor[SLICE_CLUSTERS];
+    GLuint spot_cursor[SLICE_CLUSTERS];
+    GLuint offset = 0;
+    for (int c = 0; c < SLICE_CLUSTERS; ++c) {
+        GpuCluster& cluster = clusters[z * SLICE_CLUSTERS + c];
+        cluster = { offset, point_counts[c], spot_counts[c], 0 };
+        point_cursor[c] = offset;
+        spot_cursor[c] = offset + point_counts[c];
+        offset += point_counts[c] + spot_counts[c];
+    }
+    std::vector<GLuint>& out = slice_indices[z];
+    out.resize(offset);
+    for (size_t i = 0; i < hits.size(); ++i) {
+        GLuint& cursor = i < point_hits ? point_cursor[hits[i].cluster] : spot_cursor[hits[i].cluster];
+        out[cursor++] = hits[i].light;
+    }
+}
+
+void ClusteredLighting::update(const Lights& lights, const glm::mat4& view, const glm::mat4& projection, int width, int height) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (projection != bounds_projection || width != bounds_width || height != bounds_height) {
+        buildBounds(projection, width, height);
+    }
+
+    point_spheres.resize(lights.pointLights.size());
+    for (size_t i = 0; i < lights.pointLights.size(); ++i) {
+        const PointLight& light = lights.pointLights[i];
+        point_spheres[i] = glm::vec4(glm::vec3(view * glm::vec4(light.position, 1.0f)), light.influenceRadius());
+    }
+    spot_spheres.resize(lights.spotLights.size());
+    for (size_t i = 0; i < lights.spotLights.size(); ++i) {
+        glm::vec4 sphere = lights.spotLights[i].boundingSphere();
+        spot_spheres[i] = glm::vec4(glm::vec3(view * glm::vec4(glm::vec3(sphere), 1.0f)), sphere.w);
+    }
+
+    clusters.resize(CLUSTER_COUNT);
+    slice_hits.resize(GRID_Z);
+    slice_indices.resize(GRID_Z);
+    parallel_for(0, GRID_Z, [this](int z) { assignSlice(z); }, 1);
+
+    // concatenate the slice lists, making the cluster offsets absolute
+    index_count = 0;
+    for (const auto& slice : slice_indices) index_count += slice.size();
+    indices.resize(index_count);
+    max_lights = 0;
+    size_t base = 0;
+    for (int z = 0; z < GRID_Z; ++z) {
+        std::copy(slice_indices[z].begin(), slice_indices[z].end(), indices.begin() + base);
+        for (int c = z * GRID_X * GRID_Y; c < (z + 1) * GRID_X * GRID_Y; ++c) {
+            clusters[c].offset += static_cast<GLuint>(base);
+            max_lights = std::max(max_lights, clusters[c].point_count + clusters[c].spot_count);
+        }
+        base += slice_indices[z].size();
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    assign_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    upload(width, height);
+}
+
+// All three blocks are rebuilt every frame, so they live in this frame's ranges of the stream buffer
+void ClusteredLighting::upload(int width, int height) {
+    StreamBuffer& memory = gpu_memory::stream();
+    StreamBuffer::Allocation grid_memory = memory.allocate(sizeof(GpuGrid));
+    StreamBuffer::Allocation cluster_memory = memory.allocate(CLUSTER_COUNT * sizeof(GpuCluster));
+    StreamBuffer::Allocation index_memory = memory.allocate(std::max<size_t>(index_count, 1) * sizeof(GLuint));
+    if (!grid_memory || !cluster_memory || !index_memory) {
+        return;
+    }
+
+    GpuGrid grid{
+        glm::uvec4(GRID_X, GRID_Y, GRID_Z, 0),
+        glm::vec4(static_cast<float>(width) / GRID_X, static_cast<float>(height) / GRID_Y, depth_scale, depth_bias)
+    };
+    std::memcpy(grid_memory.data, &grid, sizeof(grid));
+    std::memcpy(cluster_memory.data, clusters.data(), CLUSTER_COUNT * sizeof(GpuCluster));
+    if (index_count > 0) {
+        std::memcpy(index_memory.data, indices.data(), index_count * sizeof(GLuint));
+    }
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, GRID_BINDING, grid_memory.buffer, grid_memory.offset, grid_memory.size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, CLUSTERS_BINDING, cluster_memory.buffer, cluster_memory.offset, cluster_memory.size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INDICES_BINDING, index_memory.buffer, index_memory.offset, index_memory.size);
+}
+
+void ClusteredLighting::cleanup() {
+    // the buffers belong to gpu_memory::stream()
+    clusters.clear();
+    indices.clear();
+    index_count = 0;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Lights.hpp"
+
+// Clustered forward shading: the view frustum is split into GRID_X x GRID_Y screen tiles and GRID_Z
+// exponential depth slices (froxels). Every frame the point and spot lights are assigned on the CPU to the
+// froxels their bounding spheres touch, one depth slice per task on the worker threads.
+// tex.frag finds the froxel of a fragment and loops only over the lights listed for it.
+class ClusteredLighting {
+public:
+    // Must be called after the camera moved, uploads and binds the grid, cluster and index buffers
+    void update(const Lights& lights, const glm::mat4& view, const glm::mat4& projection, int width, int height);
+    void cleanup();
+
+    // Everything closer than this shares the first slice (the first slices of a pure exponential split are tiny)
+    float first_slice_depth = 5.0f;
+
+    // Statistics of the last update
+    size_t getLightIndexCount() const { return index_count; }
+    unsigned getMaxLightsPerCluster() const { return max_lights; }
+    double getAssignTimeMs() const { return assign_ms; }
+
+    static constexpr int GRID_X = 16;
+    static constexpr int GRID_Y = 9;
+    static constexpr int GRID_Z = 24;
+    static constexpr int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+    static constexpr GLuint GRID_BINDING = 4;     // uniform block ClusterGrid
+    static constexpr GLuint CLUSTERS_BINDING = 5; // storage block Clusters
+    static constexpr GLuint INDICES_BINDING = 6;  // storage block LightIndices
+
+private:
+    // Must match the ClusterGrid block in tex.frag (std140)
+    struct GpuGrid {
+        glm::uvec4 size;      // GRID_X, GRID_Y, GRID_Z, 0
+        glm::vec4 params;     // tile width and height in pixels, depth slice scale and bias
+    };
+    // Must match the Cluster struct in tex.frag (std430), the lights are at indices[offset ..]:
+    // point_count point light indices followed by spot_count spot light indices
+    struct GpuCluster {
+        GLuint offset;
+        GLuint point_count;
+        GLuint spot_count;
+        GLuint pad;
+    };
+    struct Box {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+    // Light touching a cluster of a slice (cluster index relative to the slice)
+    struct Hit {
+        GLuint cluster;
+        GLuint light;
+    };
+
+    // View space bounds of the froxels, rebuilt when the projection or the viewport changes
+    std::vector<Box> bounds;
+    std::vector<Box> column_bounds; // union of the clusters of a slice column, GRID_X per slice
+    std::vector<Box> row_bounds;    // GRID_Y per slice
+    std::vector<float> slice_depth; // GRID_Z + 1 slice borders
+    glm::mat4 bounds_projection{ 0.0f };
+    int bounds_width = 0;
+    int bounds_height = 0;
+    float depth_scale = 0.0f;
+    float depth_bias = 0.0f;
+
+    std::vector<glm::vec4> point_spheres; // view space center and radius
+    std::vector<glm::vec4> spot_spheres;
+    std::vector<GpuCluster> clusters;
+    std::vector<std::vector<Hit>> slice_hits;
+    std::vector<std::vector<GLuint>> slice_indices; // per slice, offsets in clusters are relative to them
+    std::vector<GLuint> indices;
+
+    size_t index_count = 0;
+    unsigned max_lights = 0;
+    double assign_ms = 0.0;
+
+    void buildBounds(const glm::mat4& projection, int width, int height);
+    void assignSlice(int z);
+    void collectHits(int z, const std::vector<glm::vec4>& spheres, std::vector<Hit>& hits, GLuint* counts) const;
+    void upload(int width, int height);
+};
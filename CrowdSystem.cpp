@@ -0,0 +1,186 @@
+#include "CrowdSystem.hpp"
+#include "GLState.hpp"
+#include "GpuAllocator.hpp"
+#include "Maze.hpp"
+#include "Parallel.hpp"
+#include "assets.hpp"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+void CrowdSystem::initialize(const cv::Mat& maze_map, GLuint shaderID) {
+    this->maze_map = maze_map;
+    shaderProgram = shaderID;
+    if (shaderProgram == 0) {
+        std::cerr << "CrowdSystem: Invalid shader program ID" << std::endl;
+    }
+    initMesh();
+}
+
+int CrowdSystem::addGoal(const glm::vec3& world_pos) {
+    goals.push_back(maze::worldToCell(world_pos));
+    return static_cast<int>(goals.size()) - 1;
+}
+
+void CrowdSystem::buildFlowFields() {
+    auto start = std::chrono::high_resolution_clock::now();
+    fields.assign(goals.size(), FlowField());
+    parallel_for(0, static_cast<int>(goals.size()), [&](int i) {
+        fields[i].build(maze_map, goals[i]);
+    }, 1);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Crowd flow fields for " << goals.size() << " goals built in "
+        << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+}
+
+// xorshift, cheap enough to be used per agent
+static unsigned nextRandom(unsigned& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+glm::vec3 CrowdSystem::randomFreePosition(unsigned& state, int goal_index) const {
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        int x = static_cast<int>(nextRandom(state) % static_cast<unsigned>(maze_map.cols));
+        int y = static_cast<int>(nextRandom(state) % static_cast<unsigned>(maze_map.rows));
+        if (!maze::isWall(maze_map, x, y) && fields[goal_index].cost(x, y) < FlowField::UNREACHABLE) {
+            return maze::cellCenter(x, y);
+        }
+    }
+    return maze::cellCenter(goals[goal_index].x, goals[goal_index].y);
+}
+
+void CrowdSystem::spawnAgents(size_t count, unsigned seed) {
+    if (fields.empty()) {
+        std::cerr << "CrowdSystem: no flow fields, call buildFlowFields() first" << std::endl;
+        return;
+    }
+    unsigned state = seed ? seed : 1;
+    respawn_state = state * 2654435761u + 12345u;
+    for (size_t i = 0; i < count; ++i) {
+        int g = static_cast<int>(i % fields.size());
+        glm::vec3 pos = randomFreePosition(state, g);
+        pos_x.push_back(pos.x);
+        pos_z.push_back(pos.z);
+        vel_x.push_back(0.0f);
+        vel_z.push_back(0.0f);
+        goal.push_back(g);
+        arrived.push_back(0);
+    }
+}
+
+void CrowdSystem::update(float dt) {
+    if (fields.empty()) {
+        return;
+    }
+
+    int count = static_cast<int>(pos_x.size());
+    parallel_for(0, count, [&](int i) {
+        const FlowField& field = fields[goal[i]];
+        glm::vec3 pos(pos_x[i], 0.0f, pos_z[i]);
+        glm::vec2 desired = field.direction(pos) * maxSpeed;
+
+        float blend = std::min(1.0f, steering * dt);
+        vel_x[i] += (desired.x - vel_x[i]) * blend;
+        vel_z[i] += (desired.y - vel_z[i]) * blend;
+
+        // Move, sliding along walls axis by axis
+        float nx = pos_x[i] + vel_x[i] * dt;
+        float nz = pos_z[i] + vel_z[i] * dt;
+        glm::ivec2 cell = maze::worldToCell(glm::vec3(nx, 0.0f, pos_z[i]));
+        if (!maze::isWall(maze_map, cell.x, cell.y)) pos_x[i] = nx;
+        else vel_x[i] = 0.0f;
+        cell = maze::worldToCell(glm::vec3(pos_x[i], 0.0f, nz));
+        if (!maze::isWall(maze_map, cell.x, cell.y)) pos_z[i] = nz;
+        else vel_z[i] = 0.0f;
+
+        cell = maze::worldToCell(glm::vec3(pos_x[i], 0.0f, pos_z[i]));
+        arrived[i] = field.cost(cell.x, cell.y) < 1.5f ? 1 : 0;
+    }, 256);
+
+    // Agents that reached their goal start over somewhere else
+    for (int i = 0; i < count; ++i) {
+        if (!arrived[i]) continue;
+        glm::vec3 pos = randomFreePosition(respawn_state, goal[i]);
+        pos_x[i] = pos.x;
+        pos_z[i] = pos.z;
+        vel_x[i] = vel_z[i] = 0.0f;
+        arrived[i] = 0;
+    }
+}
+
+void CrowdSystem::initMesh() {
+    // Unit box standing on the ground, 4 vertices per face for flat normals
+    const glm::vec3 n[6] = { {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1} };
+    std::vector<vertex> vertices;
+    std::vector<GLuint> indices;
+    for (int f = 0; f < 6; ++f) {
+        glm::vec3 normal = n[f];
+        glm::vec3 u = std::abs(normal.y) > 0.5f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+        glm::vec3 v = glm::cross(normal, u);
+        GLuint base = static_cast<GLuint>(vertices.size());
+        glm::vec3 corners[4] = { normal - u - v, normal + u - v, normal + u + v, normal - u + v };
+        for (auto& c : corners) {
+            glm::vec3 p = c * 0.5f;
+            p.x *= 0.6f;
+            p.z *= 0.6f;
+            p.y = (p.y + 0.5f) * agentHeight;
+            vertices.emplace_back(p, glm::vec2(0.0f), normal);
+        }
+        indices.insert(indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+    }
+    index_count = static_cast<GLsizei>(indices.size());
+
+    glCreateVertexArrays(1, &VAO);
+    glCreateBuffers(1, &VBO);
+    glNamedBufferData(VBO, vertices.size() * sizeof(vertex), vertices.data(), GL_STATIC_DRAW);
+    glCreateBuffers(1, &EBO);
+    glNamedBufferData(EBO, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+    glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(vertex));
+    glVertexArrayElementBuffer(VAO, EBO);
+
+    glEnableVertexArrayAttrib(VAO, 0); // position
+    glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, position));
+    glVertexArrayAttribBinding(VAO, 0, 0);
+
+    glEnableVertexArrayAttrib(VAO, 1); // normal
+    glVertexArrayAttribFormat(VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, normal));
+    glVertexArrayAttribBinding(VAO, 1, 0);
+
+    glEnableVertexArrayAttrib(VAO, 2); // per instance: x, z, heading, goal, bound each frame from the stream buffer
+    glVertexArrayAttribFormat(VAO, 2, 4, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(VAO, 2, 1);
+    glVertexArrayBindingDivisor(VAO, 1, 1);
+}
+
+void CrowdSystem::render() {
+    size_t count = pos_x.size();
+    if (count == 0 || shaderProgram == 0) {
+        return;
+    }
+
+    StreamBuffer::Allocation instances = gpu_memory::stream().allocate(count * sizeof(glm::vec4), sizeof(glm::vec4));
+    if (!instances) {
+        return;
+    }
+    glm::vec4* instance_data = static_cast<glm::vec4*>(instances.data);
+    parallel_for(0, static_cast<int>(count), [&](int i) {
+        instance_data[i] = glm::vec4(pos_x[i], pos_z[i], std::atan2(vel_x[i], vel_z[i]), static_cast<float>(goal[i]));
+    }, 1024);
+    glVertexArrayVertexBuffer(VAO, 1, instances.buffer, instances.offset, sizeof(glm::vec4));
+
+    gl_state::useProgram(shaderProgram);
+
+    gl_state::bindVertexArray(VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(count));
+}
+
+void CrowdSystem::cleanup() {
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &VBO);
+    gl_state::deleteVertexArrays(1, &VAO);
+    VAO = VBO = EBO = 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include <opencv2/opencv.hpp>
+#include <glm/glm.hpp>
+#include "FlowField.hpp"
+
+// Crowd of agents navigating maze_map by flow field lookup instead of per-agent path finding.
+// Every goal owns one FlowField; agent state is kept as structure of arrays and updated in parallel,
+// all agents are drawn with a single instanced draw call.
+class CrowdSystem {
+public:
+    CrowdSystem() : respawn_state(12345u) {}
+
+    void initialize(const cv::Mat& maze_map, GLuint shaderID);
+    int addGoal(const glm::vec3& world_pos);
+    // Builds the flow fields of all goals, one goal per thread
+    void buildFlowFields();
+    void spawnAgents(size_t count, unsigned seed = 1);
+
+    void update(float dt);
+    void render(); // with the camera of the Frame block (FrameUniforms)
+    void cleanup();
+
+    size_t getAgentCount() const { return pos_x.size(); }
+
+    float maxSpeed = 6.0f;
+    float steering = 4.0f;
+    float agentHeight = 2.0f;
+
+private:
+    cv::Mat maze_map;
+    std::vector<glm::ivec2> goals;
+    std::vector<FlowField> fields;
+
+    // Agent state (structure of arrays)
+    std::vector<float> pos_x;
+    std::vector<float> pos_z;
+    std::vector<float> vel_x;
+    std::vector<float> vel_z;
+    std::vector<int> goal;
+    std::vector<unsigned char> arrived;
+    unsigned respawn_state; // random state of the respawns in update(), reseeded by spawnAgents()
+
+    GLuint shaderProgram = 0;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLsizei index_count = 0;
+
+    void initMesh();
+    glm::vec3 randomFreePosition(unsigned& state, int goal_index) const;
+};
@@ -0,0 +1,80 @@
+#include "DeferredRenderer.hpp"
+#include "GLState.hpp"
+#include <iostream>
+
+void DeferredRenderer::init() {
+    lighting_program = ShaderProgram("resources/shaders/deferred_light.vert", "resources/shaders/deferred_light.frag");
+    glCreateVertexArrays(1, &VAO);
+}
+
+void DeferredRenderer::resize(int new_width, int new_height) {
+    glDeleteFramebuffers(1, &fbo);
+    gl_state::deleteTextures(1, &albedo_texture);
+    gl_state::deleteTextures(1, &normal_texture);
+    gl_state::deleteTextures(1, &depth_texture);
+    width = new_width;
+    height = new_height;
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &albedo_texture);
+    glTextureStorage2D(albedo_texture, 1, GL_RGBA8, width, height);
+    glCreateTextures(GL_TEXTURE_2D, 1, &normal_texture);
+    glTextureStorage2D(normal_texture, 1, GL_RGB10_A2, width, height);
+    // same format as the default framebuffer, HiZCuller blits the depth of the bound framebuffer
+    glCreateTextures(GL_TEXTURE_2D, 1, &depth_texture);
+    glTextureStorage2D(depth_texture, 1, GL_DEPTH24_STENCIL8, width, height);
+    for (GLuint texture : { albedo_texture, normal_texture, depth_texture }) {
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    glCreateFramebuffers(1, &fbo);
+    glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, albedo_texture, 0);
+    glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT1, normal_texture, 0);
+    glNamedFramebufferTexture(fbo, GL_DEPTH_STENCIL_ATTACHMENT, depth_texture, 0);
+    const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glNamedFramebufferDrawBuffers(fbo, 2, draw_buffers);
+    if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "DeferredRenderer: G-buffer is incomplete" << std::endl;
+    }
+}
+
+void DeferredRenderer::beginGeometryPass(int new_width, int new_height) {
+    if (new_width != width || new_height != height) {
+        resize(new_width, new_height);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    gl_state::disable(GL_BLEND); // the G-buffer stores values, not colors
+    const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const GLfloat far_depth = 1.0f;
+    glClearNamedFramebufferfv(fbo, GL_COLOR, 0, zero);
+    glClearNamedFramebufferfv(fbo, GL_COLOR, 1, zero);
+    glClearNamedFramebufferfv(fbo, GL_DEPTH, 0, &far_depth);
+}
+
+void DeferredRenderer::lightingPass() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl_state::enable(GL_BLEND);
+
+    lighting_program.activate();
+    gl_state::bindTextureUnit(0, albedo_texture);
+    gl_state::bindTextureUnit(1, normal_texture);
+    gl_state::bindTextureUnit(2, depth_texture);
+
+    // the shader writes the G-buffer depth, empty pixels are discarded and keep the clear color
+    GLenum depth_func = gl_state::getDepthFunc();
+    gl_state::depthFunc(GL_ALWAYS);
+    gl_state::bindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    gl_state::depthFunc(depth_func);
+}
+
+void DeferredRenderer::cleanup() {
+    glDeleteFramebuffers(1, &fbo);
+    gl_state::deleteTextures(1, &albedo_texture);
+    gl_state::deleteTextures(1, &normal_texture);
+    gl_state::deleteTextures(1, &depth_texture);
+    gl_state::deleteVertexArrays(1, &VAO);
+    fbo = albedo_texture = normal_texture = depth_texture = VAO = 0;
+    width = height = 0;
+    lighting_program.clear();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "ShaderProgram.hpp"
+
+// Deferred shading of the opaque geometry.
+// The geometry pass draws with the regular tex program switched to G-buffer output (uGBufferPass),
+// writing albedo, world normal and depth into single sampled textures. The lighting pass is one
+// fullscreen triangle that shades every pixel once with the sun and the clustered light lists
+// (ClusteredLighting must be updated for the frame) and writes the depth into the default framebuffer,
+// so the forward passes that follow (transparent objects, particles, crowd) are depth tested as usual.
+class DeferredRenderer {
+public:
+    void init();
+    void cleanup();
+
+    // Binds and clears the G-buffer, (re)creating it when the size changed
+    void beginGeometryPass(int width, int height);
+    // Binds the default framebuffer and shades it from the G-buffer, with the camera of the Frame block (FrameUniforms)
+    void lightingPass();
+
+    bool isReady() const { return lighting_program.getID() != 0; }
+
+private:
+    ShaderProgram lighting_program;
+    GLuint VAO = 0; // attribute-less fullscreen triangle
+
+    GLuint fbo = 0;
+    GLuint albedo_texture = 0; // RGB: texture color, A: alpha
+    GLuint normal_texture = 0; // world normal * 0.5 + 0.5
+    GLuint depth_texture = 0;
+    int width = 0;
+    int height = 0;
+
+    void resize(int new_width, int new_height);
+};
@@ -0,0 +1,148 @@
+#include "DistanceField.hpp"
+#include "Maze.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace {
+    // "Infinity" of the squared distance; large but still safe to add small numbers to
+    constexpr float DT_INF = 1e20f;
+}
+
+void DistanceField::build(const cv::Mat& maze_map) {
+    std::vector<unsigned char> walls(static_cast<size_t>(maze_map.cols) * maze_map.rows);
+    parallel_for(0, maze_map.rows, [&](int y) {
+        for (int x = 0; x < maze_map.cols; ++x) {
+            walls[static_cast<size_t>(y) * maze_map.cols + x] = maze_map.at<uchar>(y, x) == maze::WALL ? 1 : 0;
+        }
+    });
+    build(walls, maze_map.cols, maze_map.rows);
+}
+
+void DistanceField::build(const std::vector<unsigned char>& walls, int w, int h) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    width = w;
+    height = h;
+    distances.assign(static_cast<size_t>(w) * h, DT_INF);
+
+    // Pass 1: every row independently, squared distance along X
+    parallel_chunks(0, h, [&](int, int from, int to) {
+        std::vector<float> f(w);
+        std::vector<int> v(w);
+        std::vector<float> z(w + 1);
+        for (int y = from; y < to; ++y) {
+            const unsigned char* row = &walls[static_cast<size_t>(y) * w];
+            for (int x = 0; x < w; ++x) {
+                f[x] = row[x] ? 0.0f : DT_INF;
+            }
+            transform1D(f.data(), &distances[static_cast<size_t>(y) * w], w, v.data(), z.data());
+        }
+    });
+
+    // Pass 2: every column independently, adds the squared distance along Y
+    parallel_chunks(0, w, [&](int, int from, int to) {
+        std::vector<float> f(h);
+        std::vector<float> d(h);
+        std::vector<int> v(h);
+        std::vector<float> z(h + 1);
+        for (int x = from; x < to; ++x) {
+            for (int y = 0; y < h; ++y) {
+                f[y] = distances[static_cast<size_t>(y) * w + x];
+            }
+            transform1D(f.data(), d.data(), h, v.data(), z.data());
+            for (int y = 0; y < h; ++y) {
+                distances[static_cast<size_t>(y) * w + x] = std::sqrt(d[y]);
+            }
+        }
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+    build_time_ms = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// 1D squared distance transform of sampled function f (lower envelope of parabolas)
+void DistanceField::transform1D(const float* f, float* d, int n, int* v, float* z) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -DT_INF;
+    z[1] = DT_INF;
+    for (int q = 1; q < n; ++q) {
+        float s = ((f[q] + static_cast<float>(q) * q) - (f[v[k]] + static_cast<float>(v[k]) * v[k]))
+            / (2.0f * q - 2.0f * v[k]);
+        while (s <= z[k]) {
+            --k;
+            s = ((f[q] + static_cast<float>(q) * q) - (f[v[k]] + static_cast<float>(v[k]) * v[k]))
+                / (2.0f * q - 2.0f * v[k]);
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = DT_INF;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q) {
+            ++k;
+        }
+        float dq = static_cast<float>(q - v[k]);
+        d[q] = dq * dq + f[v[k]];
+    }
+}
+
+void DistanceField::clear() {
+    distances.clear();
+    distances.shrink_to_fit();
+    width = 0;
+    height = 0;
+}
+
+float DistanceField::at(int x, int y) const {
+    if (distances.empty()) {
+        return std::sqrt(DT_INF);
+    }
+    x = std::clamp(x, 0, width - 1);
+    y = std::clamp(y, 0, height - 1);
+    return distances[static_cast<size_t>(y) * width + x];
+}
+
+float DistanceField::sample(const glm::vec3& world_pos) const {
+    float fx = world_pos.x / maze::TILE_SIZE - 0.5f;
+    float fy = world_pos.z / maze::TILE_SIZE - 0.5f;
+    int x0 = static_cast<int>(std::floor(fx));
+    int y0 = static_cast<int>(std::floor(fy));
+    float tx = fx - x0;
+    float ty = fy - y0;
+
+    float top = at(x0, y0) * (1.0f - tx) + at(x0 + 1, y0) * tx;
+    float bottom = at(x0, y0 + 1) * (1.0f - tx) + at(x0 + 1, y0 + 1) * tx;
+    return (top * (1.0f - ty) + bottom * ty) * maze::TILE_SIZE;
+}
+
+glm::vec3 DistanceField::gradient(const glm::vec3& world_pos) const {
+    const float h = 0.5f * maze::TILE_SIZE;
+    float dx = sample(world_pos + glm::vec3(h, 0.0f, 0.0f)) - sample(world_pos - glm::vec3(h, 0.0f, 0.0f));
+    float dz = sample(world_pos + glm::vec3(0.0f, 0.0f, h)) - sample(world_pos - glm::vec3(0.0f, 0.0f, h));
+    glm::vec3 g(dx, 0.0f, dz);
+    float len = glm::length(g);
+    return len > 0.0f ? g / len : glm::vec3(0.0f);
+}
+
+double DistanceField::benchmark(int size, float wall_density) {
+    std::mt19937 gen(42);
+    std::bernoulli_distribution wall(wall_density);
+    std::vector<unsigned char> walls(static_cast<size_t>(size) * size);
+    for (auto& cell : walls) {
+        cell = wall(gen) ? 1 : 0;
+    }
+
+    DistanceField field;
+    field.build(walls, size, size);
+    std::cout << "DistanceField benchmark: " << size << "x" << size << " map built in "
+        << field.getBuildTimeMs() << " ms using " << parallel_worker_count() << " threads" << std::endl;
+    return field.getBuildTimeMs();
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <glm/glm.hpp>
+
+// Exact Euclidean distance transform of maze_map (distance to the nearest wall cell).
+// Built with the separable Felzenszwalb-Huttenlocher algorithm: one 1D pass over all rows
+// and one over all columns, each pass split across threads.
+class DistanceField {
+public:
+    DistanceField() = default;
+
+    void build(const cv::Mat& maze_map);
+    void clear();
+
+    bool empty() const { return distances.empty(); }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Distance in cells from the cell center to the nearest wall cell center (huge if there is no wall)
+    float at(int x, int y) const;
+    // Bilinearly filtered distance in world units for a world position on the XZ plane
+    float sample(const glm::vec3& world_pos) const;
+    // Gradient pointing away from the nearest wall
+    glm::vec3 gradient(const glm::vec3& world_pos) const;
+
+    const std::vector<float>& data() const { return distances; }
+    double getBuildTimeMs() const { return build_time_ms; }
+
+    // Builds the field for a random size x size map and returns the build time in milliseconds
+    static double benchmark(int size = 4096, float wall_density = 0.3f);
+
+private:
+    std::vector<float> distances;
+    int width = 0;
+    int height = 0;
+    double build_time_ms = 0.0;
+
+    void build(const std::vector<unsigned char>& walls, int w, int h);
+    static void transform1D(const float* f, float* d, int n, int* v, float* z);
+};
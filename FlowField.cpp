@@ -0,0 +1,94 @@
+#include "FlowField.hpp"
+#include "Maze.hpp"
+#include "Parallel.hpp"
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+namespace {
+    const int NEIGHBOUR_DX[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+    const int NEIGHBOUR_DY[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+    const float NEIGHBOUR_COST[8] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f };
+}
+
+void FlowField::build(const cv::Mat& maze_map, glm::ivec2 goal_cell) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    width = maze_map.cols;
+    height = maze_map.rows;
+    goal = goal_cell;
+    integration.assign(static_cast<size_t>(width) * height, UNREACHABLE);
+    flow.assign(static_cast<size_t>(width) * height, glm::vec2(0.0f));
+    if (maze::isWall(maze_map, goal.x, goal.y)) {
+        return;
+    }
+
+    auto canStep = [&](int x, int y, int n) {
+        int nx = x + NEIGHBOUR_DX[n];
+        int ny = y + NEIGHBOUR_DY[n];
+        if (maze::isWall(maze_map, nx, ny)) return false;
+        // no cutting of wall corners
+        if (n >= 4 && (maze::isWall(maze_map, nx, y) || maze::isWall(maze_map, x, ny))) return false;
+        return true;
+    };
+
+    // Integration field: Dijkstra from the goal (a single source expansion is inherently sequential)
+    using Entry = std::pair<float, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    integration[static_cast<size_t>(goal.y) * width + goal.x] = 0.0f;
+    open.emplace(0.0f, goal.y * width + goal.x);
+    while (!open.empty()) {
+        auto [c, index] = open.top();
+        open.pop();
+        if (c > integration[index]) continue;
+        int x = index % width;
+        int y = index / width;
+        for (int n = 0; n < 8; ++n) {
+            if (!canStep(x, y, n)) continue;
+            int ni = (y + NEIGHBOUR_DY[n]) * width + x + NEIGHBOUR_DX[n];
+            float nc = c + NEIGHBOUR_COST[n];
+            if (nc < integration[ni]) {
+                integration[ni] = nc;
+                open.emplace(nc, ni);
+            }
+        }
+    }
+
+    // Flow field: every tile points to its cheapest reachable neighbour, rows in parallel
+    parallel_for(0, height, [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            size_t index = static_cast<size_t>(y) * width + x;
+            if (integration[index] >= UNREACHABLE || integration[index] == 0.0f) continue;
+            float best = integration[index];
+            glm::vec2 dir(0.0f);
+            for (int n = 0; n < 8; ++n) {
+                if (!canStep(x, y, n)) continue;
+                float nc = integration[static_cast<size_t>(y + NEIGHBOUR_DY[n]) * width + x + NEIGHBOUR_DX[n]];
+                if (nc < best) {
+                    best = nc;
+                    dir = glm::vec2(static_cast<float>(NEIGHBOUR_DX[n]), static_cast<float>(NEIGHBOUR_DY[n]));
+                }
+            }
+            flow[index] = dir == glm::vec2(0.0f) ? dir : glm::normalize(dir);
+        }
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+    build_time_ms = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+float FlowField::cost(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return UNREACHABLE;
+    }
+    return integration[static_cast<size_t>(y) * width + x];
+}
+
+glm::vec2 FlowField::direction(const glm::vec3& world_pos) const {
+    glm::ivec2 tile = maze::worldToCell(world_pos);
+    if (tile.x < 0 || tile.y < 0 || tile.x >= width || tile.y >= height) {
+        return glm::vec2(0.0f);
+    }
+    return flow[static_cast<size_t>(tile.y) * width + tile.x];
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <glm/glm.hpp>
+
+// Navigation field towards one goal cell of maze_map.
+// The integration field holds the path cost from every tile to the goal (8-connected Dijkstra,
+// diagonal moves only when both side tiles are free), the flow field stores for every tile
+// the unit direction to its cheapest neighbour, so agents steer by a single lookup.
+class FlowField {
+public:
+    FlowField() = default;
+
+    void build(const cv::Mat& maze_map, glm::ivec2 goal_cell);
+
+    bool empty() const { return integration.empty(); }
+    glm::ivec2 getGoal() const { return goal; }
+    // Path cost in tiles to the goal, huge if the goal can not be reached
+    float cost(int x, int y) const;
+    // Unit direction on the XZ plane (x, z) for the tile under the world position
+    glm::vec2 direction(const glm::vec3& world_pos) const;
+    double getBuildTimeMs() const { return build_time_ms; }
+
+    static constexpr float UNREACHABLE = 1e30f;
+
+private:
+    int width = 0;
+    int height = 0;
+    glm::ivec2 goal{ 0 };
+    std::vector<float> integration;
+    std::vector<glm::vec2> flow;
+    double build_time_ms = 0.0;
+};
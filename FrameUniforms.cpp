@@ -0,0 +1,24 @@
+#include "FrameUniforms.hpp"
+#include "GpuAllocator.hpp"
+#include <algorithm>
+#include <cstring>
+
+void FrameUniforms::update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& camera_position,
+    float time, int width, int height) {
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+    frame.view = view;
+    frame.projection = projection;
+    frame.view_projection = projection * view;
+    frame.inverse_view_projection = glm::inverse(frame.view_projection);
+    frame.camera_position = camera_position;
+    frame.time = time;
+    frame.viewport = glm::vec4(width, height, 1.0f / width, 1.0f / height);
+
+    StreamBuffer::Allocation memory = gpu_memory::stream().allocate(sizeof(GpuFrame));
+    if (!memory) {
+        return;
+    }
+    std::memcpy(memory.data, &frame, sizeof(GpuFrame));
+    glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, memory.buffer, memory.offset, memory.size);
+}
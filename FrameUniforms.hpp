@@ -0,0 +1,31 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Frame block (std140) of every shader program
+struct GpuFrame {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 view_projection;
+    glm::mat4 inverse_view_projection;
+    glm::vec3 camera_position;
+    float time;                // seconds
+    glm::vec4 viewport;        // width, height, 1 / width, 1 / height
+};
+static_assert(sizeof(GpuFrame) == 288, "GpuFrame must match the std140 Frame block of the shaders");
+
+// Camera and frame constants written once per frame into the stream buffer and bound at BINDING,
+// where every program reads them instead of its own view / projection uniforms.
+// update() has to run after StreamBuffer::beginFrame() and before the first draw of the frame.
+class FrameUniforms {
+public:
+    static constexpr GLuint BINDING = 0;
+
+    void update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& camera_position,
+        float time, int width, int height);
+
+    const GpuFrame& get() const { return frame; }
+
+private:
+    GpuFrame frame{};
+};
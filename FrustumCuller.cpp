@@ -0,0 +1,125 @@
+#include "FrustumCuller.hpp"
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_SSE 1
+#endif
+
+void FrustumCuller::setViewProjection(const glm::mat4& m) {
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0; // left
+    planes[1] = row3 - row0; // right
+    planes[2] = row3 + row1; // bottom
+    planes[3] = row3 - row1; // top
+    planes[4] = row3 + row2; // near
+    planes[5] = row3 - row2; // far
+    for (auto& p : planes) {
+        float len = glm::length(glm::vec3(p));
+        if (len > 0.0f) p /= len;
+    }
+}
+
+bool FrustumCuller::isBoxVisible(const glm::vec3& box_min, const glm::vec3& box_max) const {
+    glm::vec3 c = (box_min + box_max) * 0.5f;
+    glm::vec3 e = (box_max - box_min) * 0.5f;
+    for (const auto& p : planes) {
+        glm::vec3 n(p);
+        if (glm::dot(n, c) + p.w + glm::dot(glm::abs(n), e) < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FrustumCuller::cullBoxes(const float* cx, const float* cy, const float* cz,
+    const float* ex, const float* ey, const float* ez, size_t count, std::vector<unsigned>& visible_indices) const {
+    size_t i = 0;
+#if defined(FRUSTUM_AVX)
+    const __m256 zero = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i), z = _mm256_loadu_ps(cz + i);
+        __m256 hx = _mm256_loadu_ps(ex + i), hy = _mm256_loadu_ps(ey + i), hz = _mm256_loadu_ps(ez + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& p : planes) {
+            // signed distance of the center + projected radius of the box on the plane normal
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(p.x)), _mm256_mul_ps(y, _mm256_set1_ps(p.y))),
+                _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(p.z)), _mm256_set1_ps(p.w)));
+            __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(hx, _mm256_set1_ps(std::abs(p.x))), _mm256_mul_ps(hy, _mm256_set1_ps(std::abs(p.y)))),
+                _mm256_mul_ps(hz, _mm256_set1_ps(std::abs(p.z))));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        while (mask) {
+            int bit = 0;
+            while (!(mask & (1 << bit))) bit++;
+            visible_indices.push_back(static_cast<unsigned>(i + bit));
+            mask &= mask - 1;
+        }
+    }
+#elif defined(FRUSTUM_SSE)
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i), z = _mm_loadu_ps(cz + i);
+        __m128 hx = _mm_loadu_ps(ex + i), hy = _mm_loadu_ps(ey + i), hz = _mm_loadu_ps(ez + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& p : planes) {
+            // signed distance of the center + projected radius of the box on the plane normal
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(p.x)), _mm_mul_ps(y, _mm_set1_ps(p.y))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(p.z)), _mm_set1_ps(p.w)));
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, _mm_set1_ps(std::abs(p.x))), _mm_mul_ps(hy, _mm_set1_ps(std::abs(p.y)))),
+                _mm_mul_ps(hz, _mm_set1_ps(std::abs(p.z))));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; ++k) {
+            if (mask & (1 << k)) visible_indices.push_back(static_cast<unsigned>(i + k));
+        }
+    }
+#endif
+    // Scalar tail (or the whole range without SIMD)
+    for (; i < count; ++i) {
+        bool inside = true;
+        for (const auto& p : planes) {
+            float d = cx[i] * p.x + cy[i] * p.y + cz[i] * p.z + p.w;
+            float r = ex[i] * std::abs(p.x) + ey[i] * std::abs(p.y) + ez[i] * std::abs(p.z);
+            if (d + r < 0.0f) {
+                inside = false;
+                break;
+            }
+        }
+        if (inside) visible_indices.push_back(static_cast<unsigned>(i));
+    }
+}
+
+void FrustumCuller::cull(const std::vector<Model*>& candidates, std::vector<Model*>& visible) {
+    size_t count = candidates.size();
+    center_x.resize(count); center_y.resize(count); center_z.resize(count);
+    extent_x.resize(count); extent_y.resize(count); extent_z.resize(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 bmin, bmax;
+        candidates[i]->getWorldBounds(bmin, bmax);
+        glm::vec3 c = (bmin + bmax) * 0.5f;
+        glm::vec3 e = (bmax - bmin) * 0.5f;
+        center_x[i] = c.x; center_y[i] = c.y; center_z[i] = c.z;
+        extent_x[i] = e.x; extent_y[i] = e.y; extent_z[i] = e.z;
+    }
+
+    indices.clear();
+    cullBoxes(center_x.data(), center_y.data(), center_z.data(),
+        extent_x.data(), extent_y.data(), extent_z.data(), count, indices);
+    for (unsigned index : indices) {
+        visible.push_back(candidates[index]);
+    }
+
+    tested += count;
+    passed += indices.size();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Model.hpp"
+
+// View frustum culling of draw lists on the CPU.
+// World AABBs of the candidates are gathered into structure-of-arrays (center / extent) and tested
+// against the six frustum planes 4 boxes at a time with SSE (8 with AVX), producing compacted visible lists.
+class FrustumCuller {
+public:
+    // Gribb-Hartmann plane extraction from projection * view, planes are normalized (xyz = normal, w = distance)
+    void setViewProjection(const glm::mat4& view_projection);
+
+    // Appends the visible objects of candidates to visible (in the original order)
+    void cull(const std::vector<Model*>& candidates, std::vector<Model*>& visible);
+    // Kernel on raw SoA data: indices of the boxes intersecting the frustum
+    void cullBoxes(const float* cx, const float* cy, const float* cz,
+        const float* ex, const float* ey, const float* ez, size_t count, std::vector<unsigned>& visible_indices) const;
+
+    bool isBoxVisible(const glm::vec3& box_min, const glm::vec3& box_max) const;
+    const glm::vec4* getPlanes() const { return planes; }
+
+    // Statistics since the last resetStats()
+    void resetStats() { tested = 0; passed = 0; }
+    size_t getTested() const { return tested; }
+    size_t getVisible() const { return passed; }
+    size_t getCulled() const { return tested - passed; }
+
+private:
+    glm::vec4 planes[6];
+    size_t tested = 0;
+    size_t passed = 0;
+
+    // Per frame scratch memory, reused to avoid allocations
+    std::vector<float> center_x, center_y, center_z;
+    std::vector<float> extent_x, extent_y, extent_z;
+    std::vector<unsigned> indices;
+};
@@ -0,0 +1,177 @@
+#include "GLState.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    constexpr GLuint UNKNOWN = ~0u;
+    constexpr GLuint MAX_UNITS = 32; // units above are not cached
+    constexpr GLenum CAPABILITIES[] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_PROGRAM_POINT_SIZE, GL_MULTISAMPLE };
+    constexpr int CAPABILITY_COUNT = static_cast<int>(std::size(CAPABILITIES));
+
+    struct State {
+        GLuint program = UNKNOWN;
+        GLuint vertex_array = UNKNOWN;
+        GLuint textures[MAX_UNITS];
+        GLuint enabled[CAPABILITY_COUNT]; // 0, 1 or UNKNOWN
+        GLenum blend_source = UNKNOWN;
+        GLenum blend_destination = UNKNOWN;
+        GLenum depth_function = UNKNOWN;
+        GLuint depth_mask = UNKNOWN;
+        GLuint color_mask = UNKNOWN;
+        GLenum cull_face = UNKNOWN;
+
+        State() {
+            std::fill(std::begin(textures), std::end(textures), UNKNOWN);
+            std::fill(std::begin(enabled), std::end(enabled), UNKNOWN);
+        }
+    };
+
+    State state;
+    gl_state::Stats stats;
+
+    // true when the driver has to be called
+    template <typename T>
+    bool change(T& current, T value) {
+        if (current == value) {
+            stats.elided++;
+            return false;
+        }
+        current = value;
+        stats.issued++;
+        return true;
+    }
+
+    int capabilityIndex(GLenum capability) {
+        for (int i = 0; i < CAPABILITY_COUNT; ++i) {
+            if (CAPABILITIES[i] == capability) return i;
+        }
+        return -1;
+    }
+}
+
+namespace gl_state {
+    void useProgram(GLuint program) {
+        if (change(state.program, program)) glUseProgram(program);
+    }
+
+    void bindVertexArray(GLuint vertex_array) {
+        if (change(state.vertex_array, vertex_array)) glBindVertexArray(vertex_array);
+    }
+
+    void bindTextureUnit(GLuint unit, GLuint texture) {
+        if (unit >= MAX_UNITS) {
+            stats.issued++;
+            glBindTextureUnit(unit, texture);
+            return;
+        }
+        if (change(state.textures[unit], texture)) glBindTextureUnit(unit, texture);
+    }
+
+    void bindTextures(GLuint first, GLsizei count, const GLuint* textures) {
+        bool same = first + count <= MAX_UNITS;
+        for (GLsizei i = 0; same && i < count; ++i) {
+            same = state.textures[first + i] == (textures ? textures[i] : 0);
+        }
+        if (same) {
+            stats.elided++;
+            return;
+        }
+        for (GLsizei i = 0; i < count && first + i < MAX_UNITS; ++i) {
+            state.textures[first + i] = textures ? textures[i] : 0;
+        }
+        stats.issued++;
+        glBindTextures(first, count, textures);
+    }
+
+    void setEnabled(GLenum capability, bool enabled) {
+        int index = capabilityIndex(capability);
+        if (index >= 0 && !change(state.enabled[index], static_cast<GLuint>(enabled))) {
+            return;
+        }
+        if (index < 0) stats.issued++;
+        if (enabled) glEnable(capability);
+        else glDisable(capability);
+    }
+
+    bool isEnabled(GLenum capability) {
+        int index = capabilityIndex(capability);
+        if (index < 0) {
+            return glIsEnabled(capability) == GL_TRUE;
+        }
+        if (state.enabled[index] == UNKNOWN) {
+            state.enabled[index] = glIsEnabled(capability) == GL_TRUE ? 1 : 0;
+        }
+        return state.enabled[index] == 1;
+    }
+
+    void blendFunc(GLenum source, GLenum destination) {
+        if (state.blend_source == source && state.blend_destination == destination) {
+            stats.elided++;
+            return;
+        }
+        state.blend_source = source;
+        state.blend_destination = destination;
+        stats.issued++;
+        glBlendFunc(source, destination);
+    }
+
+    void depthFunc(GLenum function) {
+        if (change(state.depth_function, function)) glDepthFunc(function);
+    }
+
+    GLenum getDepthFunc() {
+        if (state.depth_function == UNKNOWN) {
+            GLint function = GL_LESS;
+            glGetIntegerv(GL_DEPTH_FUNC, &function);
+            state.depth_function = static_cast<GLenum>(function);
+        }
+        return state.depth_function;
+    }
+
+    void depthMask(bool write) {
+        if (change(state.depth_mask, static_cast<GLuint>(write))) glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void colorMask(bool write) {
+        GLboolean value = write ? GL_TRUE : GL_FALSE;
+        if (change(state.color_mask, static_cast<GLuint>(write))) glColorMask(value, value, value, value);
+    }
+
+    void cullFace(GLenum mode) {
+        if (change(state.cull_face, mode)) glCullFace(mode);
+    }
+
+    void deleteProgram(GLuint program) {
+        if (program != 0 && state.program == program) state.program = UNKNOWN;
+        glDeleteProgram(program);
+    }
+
+    void deleteVertexArrays(GLsizei count, const GLuint* vertex_arrays) {
+        for (GLsizei i = 0; i < count; ++i) {
+            if (vertex_arrays[i] != 0 && state.vertex_array == vertex_arrays[i]) state.vertex_array = 0; // unbound by GL
+        }
+        glDeleteVertexArrays(count, vertex_arrays);
+    }
+
+    void deleteTextures(GLsizei count, const GLuint* textures) {
+        for (GLsizei i = 0; i < count; ++i) {
+            if (textures[i] == 0) continue;
+            for (GLuint& bound : state.textures) {
+                if (bound == textures[i]) bound = 0; // unbound by GL
+            }
+        }
+        glDeleteTextures(count, textures);
+    }
+
+    void invalidate() {
+        state = State();
+    }
+
+    Stats getStats() {
+        return stats;
+    }
+
+    void resetStats() {
+        stats = Stats();
+    }
+}
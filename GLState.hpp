@@ -0,0 +1,42 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+
+// Shadow copy of the GL state that changes between draws: program, vertex array, texture units,
+// the enable bits, blend function, depth and cull state. A setter skips the driver call when the value is
+// already current and counts issued and elided calls. State tracked here has to be changed through here
+// (the ImGui backend restores whatever it changes). The delete wrappers drop deleted names from the cache,
+// the driver reuses them for new objects.
+namespace gl_state {
+    struct Stats {
+        size_t issued = 0;
+        size_t elided = 0;
+    };
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertex_array);
+    void bindTextureUnit(GLuint unit, GLuint texture);
+    void bindTextures(GLuint first, GLsizei count, const GLuint* textures);
+
+    // GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_PROGRAM_POINT_SIZE and GL_MULTISAMPLE are cached,
+    // other capabilities go to the driver every time
+    void setEnabled(GLenum capability, bool enabled);
+    inline void enable(GLenum capability) { setEnabled(capability, true); }
+    inline void disable(GLenum capability) { setEnabled(capability, false); }
+    bool isEnabled(GLenum capability); // from the cache, queried only while unknown
+    void blendFunc(GLenum source, GLenum destination);
+    void depthFunc(GLenum function);
+    GLenum getDepthFunc();
+    void depthMask(bool write);
+    void colorMask(bool write);
+    void cullFace(GLenum mode);
+
+    void deleteProgram(GLuint program);
+    void deleteVertexArrays(GLsizei count, const GLuint* vertex_arrays);
+    void deleteTextures(GLsizei count, const GLuint* textures);
+
+    // Forgets everything, the next call of every setter reaches the driver
+    void invalidate();
+    Stats getStats();
+    void resetStats();
+}
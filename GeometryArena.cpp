@@ -0,0 +1,144 @@
+#include "GeometryArena.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <tuple>
+
+void GeometryArena::init(ShaderProgram& shader) {
+    instanced_uniform = shader.uniform("uInstanced");
+    tex0_uniform = shader.uniform("tex0");
+
+    // Same attribute setup as Mesh, the buffers are bound per pool
+    glCreateVertexArrays(1, &VAO);
+    GLint position_attrib_location = shader.getAttribLocation("aPos");
+    if (position_attrib_location >= 0) {
+        glEnableVertexArrayAttrib(VAO, position_attrib_location);
+        glVertexArrayAttribFormat(VAO, position_attrib_location, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, position));
+        glVertexArrayAttribBinding(VAO, position_attrib_location, 0);
+    }
+    GLint normal_attrib_location = shader.getAttribLocation("aNorm");
+    if (normal_attrib_location >= 0) {
+        glEnableVertexArrayAttrib(VAO, normal_attrib_location);
+        glVertexArrayAttribFormat(VAO, normal_attrib_location, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, normal));
+        glVertexArrayAttribBinding(VAO, normal_attrib_location, 0);
+    }
+    GLint tex_attrib_location = shader.getAttribLocation("aTex");
+    if (tex_attrib_location >= 0) {
+        glEnableVertexArrayAttrib(VAO, tex_attrib_location);
+        glVertexArrayAttribFormat(VAO, tex_attrib_location, 2, GL_FLOAT, GL_FALSE, offsetof(vertex, texCoord));
+        glVertexArrayAttribBinding(VAO, tex_attrib_location, 0);
+    }
+}
+
+void GeometryArena::cleanup() {
+    ranges.clear();
+    gl_state::deleteVertexArrays(1, &VAO);
+    VAO = 0;
+}
+
+bool GeometryArena::add(const Mesh& mesh) {
+    const GpuAllocator::Allocation& vertices = mesh.getVertexAllocation();
+    const GpuAllocator::Allocation& indices = mesh.getIndexAllocation();
+    if (VAO == 0 || mesh.primitive_type != GL_TRIANGLES || !vertices || !indices) {
+        return false;
+    }
+    // the vertex allocator aligns to the vertex stride, so the offset is a whole number of vertices
+    ranges[&mesh] = { vertices.buffer, indices.buffer, static_cast<GLuint>(indices.offset / sizeof(GLuint)),
+        static_cast<GLuint>(mesh.indices.size()), static_cast<GLint>(vertices.offset / sizeof(vertex)) };
+    return true;
+}
+
+bool GeometryArena::contains(const Model& model) const {
+    if (model.meshes.empty()) {
+        return false;
+    }
+    for (const Mesh& mesh : model.meshes) {
+        if (!ranges.count(&mesh)) return false;
+    }
+    return true;
+}
+
+void GeometryArena::begin() {
+    queue.clear();
+}
+
+void GeometryArena::draw(const Model& model, const glm::mat4& model_matrix) {
+    for (const Mesh& mesh : model.meshes) {
+        auto found = ranges.find(&mesh);
+        if (found == ranges.end()) continue;
+        const Material& material = *mesh.material;
+        GLint array = material.texture_handle != 0 ? -1 : material.texture_array;
+        GLuint texture = material.getBoundTexture();
+        queue.push_back({ &mesh, model_matrix, found->second.vertex_buffer, found->second.index_buffer, array,
+            material.texture_handle, texture });
+    }
+}
+
+void GeometryArena::submit(ShaderProgram& shader) {
+    draw_count = queue.size();
+    multi_draw_count = 0;
+    if (queue.empty()) {
+        return;
+    }
+
+    // draws of one batch have to be contiguous in the command buffer
+    std::stable_sort(queue.begin(), queue.end(), [](const QueuedDraw& a, const QueuedDraw& b) {
+        return std::tie(a.vertex_buffer, a.index_buffer, a.texture_array, a.texture_handle, a.texture_id) <
+            std::tie(b.vertex_buffer, b.index_buffer, b.texture_array, b.texture_handle, b.texture_id);
+    });
+    // written straight into this frame's range of the stream buffer
+    StreamBuffer& memory = gpu_memory::stream();
+    StreamBuffer::Allocation record_memory = memory.allocate(queue.size() * sizeof(GpuInstance));
+    StreamBuffer::Allocation command_memory = memory.allocate(queue.size() * sizeof(DrawCommand), sizeof(GLuint));
+    if (!record_memory || !command_memory) {
+        return;
+    }
+    GpuInstance* records = static_cast<GpuInstance*>(record_memory.data);
+    DrawCommand* commands = static_cast<DrawCommand*>(command_memory.data);
+    for (size_t i = 0; i < queue.size(); ++i) {
+        const QueuedDraw& draw = queue[i];
+        const Range& range = ranges.at(draw.mesh);
+        GpuInstance record;
+        record.model = draw.model_matrix;
+        glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(draw.model_matrix)));
+        for (int c = 0; c < 3; ++c) record.normal[c] = glm::vec4(normal[c], 0.0f);
+        record.material = draw.mesh->material->getIndex();
+        records[i] = record; // one sequential write to the mapped memory
+        commands[i] = { range.count, 1, range.first_index, range.base_vertex, static_cast<GLuint>(i) };
+    }
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, InstancedRenderer::INSTANCES_BINDING, record_memory.buffer,
+        record_memory.offset, record_memory.size);
+
+    shader.activate();
+    shader.setUniform(instanced_uniform, 1);
+    shader.setUniform(tex0_uniform, 0);
+    gl_state::bindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_memory.buffer);
+    GLuint bound_vertices = 0, bound_indices = 0;
+    for (size_t first = 0; first < queue.size();) {
+        const QueuedDraw& batch = queue[first];
+        size_t last = first + 1;
+        while (last < queue.size() && queue[last].vertex_buffer == batch.vertex_buffer &&
+            queue[last].index_buffer == batch.index_buffer && queue[last].texture_array == batch.texture_array &&
+            queue[last].texture_handle == batch.texture_handle && queue[last].texture_id == batch.texture_id) {
+            last++;
+        }
+        if (batch.vertex_buffer != bound_vertices) {
+            bound_vertices = batch.vertex_buffer;
+            glVertexArrayVertexBuffer(VAO, 0, bound_vertices, 0, sizeof(vertex));
+        }
+        if (batch.index_buffer != bound_indices) {
+            bound_indices = batch.index_buffer;
+            glVertexArrayElementBuffer(VAO, bound_indices);
+        }
+        if (batch.texture_id != 0) {
+            gl_state::bindTextureUnit(0, batch.texture_id);
+        }
+        const void* offset = reinterpret_cast<const void*>(command_memory.offset + first * sizeof(DrawCommand));
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, offset, static_cast<GLsizei>(last - first), 0);
+        multi_draw_count++;
+        first = last;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    shader.setUniform(instanced_uniform, 0);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <GL/glew.h>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "GpuAllocator.hpp"
+#include "InstancedRenderer.hpp"
+#include "Model.hpp"
+#include "ShaderProgram.hpp"
+
+// Multi-draw submission of meshes living in the shared vertex / index buffers (gpu_memory).
+// All registered meshes are drawn through one VAO (the pool buffers are swapped in with
+// glVertexArrayVertexBuffer / glVertexArrayElementBuffer). A pass queues models with their world matrix;
+// submit() writes one Instance record (model / normal matrix, color) and one indirect command per mesh,
+// with the record index as base instance so tex.vert finds it at gl_BaseInstance, and draws everything
+// with one glMultiDrawElementsIndirect per pool pair and texture (array, bindless handle or bound texture).
+class GeometryArena {
+public:
+    void init(ShaderProgram& shader);
+    void cleanup();
+
+    // Registers the mesh, false for meshes the arena can not draw (not triangles, empty)
+    bool add(const Mesh& mesh);
+    // True when every mesh of the model is registered
+    bool contains(const Model& model) const;
+
+    // Starts a pass
+    void begin();
+    // Queues the meshes of the model (must be contained) with the given world matrix
+    void draw(const Model& model, const glm::mat4& model_matrix);
+    // Uploads the records and commands of the pass and draws them with the shader, leaves uInstanced off
+    void submit(ShaderProgram& shader);
+
+    // Statistics of the last submit()
+    size_t getDrawCount() const { return draw_count; }
+    size_t getMultiDrawCount() const { return multi_draw_count; }
+
+private:
+    struct DrawCommand {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+    };
+    struct Range {
+        GLuint vertex_buffer;
+        GLuint index_buffer;
+        GLuint first_index;
+        GLuint count;
+        GLint base_vertex;
+    };
+    struct QueuedDraw {
+        const Mesh* mesh;
+        glm::mat4 model_matrix;
+        // batch key
+        GLuint vertex_buffer;
+        GLuint index_buffer;
+        GLint texture_array;  // array index of the material, -1 for bindless and plain textures
+        GLuint64 texture_handle; // bindless handle, without NV_gpu_shader5 it has to be uniform per multi-draw
+        GLuint texture_id;    // Material::getBoundTexture(), 0 when nothing has to be bound
+    };
+
+    GLuint VAO = 0;
+    std::unordered_map<const Mesh*, Range> ranges;
+
+    std::vector<QueuedDraw> queue;
+
+    ShaderProgram::UniformHandle instanced_uniform, tex0_uniform;
+
+    size_t draw_count = 0;
+    size_t multi_draw_count = 0;
+};
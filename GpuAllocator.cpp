@@ -0,0 +1,305 @@
+#include "GpuAllocator.hpp"
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <numeric>
+#include "assets.hpp"
+
+static GLsizeiptr alignUp(GLsizeiptr value, GLsizeiptr alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+GpuAllocator::GpuAllocator(Usage usage, GLsizeiptr pool_size, GLsizeiptr element_size, GLbitfield storage_flags)
+    : usage(usage), pool_size(pool_size), element_size(element_size), storage_flags(storage_flags) {
+    for (auto& level : heads) std::fill(std::begin(level), std::end(level), -1);
+}
+
+GLsizeiptr GpuAllocator::getAlignment() {
+    if (alignment == 0) {
+        switch (usage) {
+        case Usage::Vertex: alignment = element_size; break;          // offset / stride is the base vertex
+        case Usage::Index: alignment = sizeof(GLuint); break;
+        case Usage::Uniform:
+        case Usage::Storage: alignment = gpu_memory::bufferOffsetAlignment(); break;
+        }
+        alignment = std::lcm(std::max<GLsizeiptr>(alignment, 1), GRANULE);
+    }
+    return alignment;
+}
+
+// Sizes below SECOND_LEVELS granules map linearly to level 0, larger ones to the power of two above them
+// split into SECOND_LEVELS classes
+void GpuAllocator::mapping(GLsizeiptr size, int& first, int& second) {
+    uint64_t units = static_cast<uint64_t>(size / GRANULE);
+    if (units < SECOND_LEVELS) {
+        first = 0;
+        second = static_cast<int>(units);
+        return;
+    }
+    int msb = std::bit_width(units) - 1;
+    first = msb - SECOND_LEVEL_BITS + 1;
+    second = static_cast<int>(units >> (msb - SECOND_LEVEL_BITS)) - SECOND_LEVELS;
+}
+
+// Every block of the class this size maps to is at least this big, so the first block found fits
+GLsizeiptr GpuAllocator::searchSize(GLsizeiptr size) {
+    uint64_t units = static_cast<uint64_t>(size / GRANULE);
+    if (units >= SECOND_LEVELS) {
+        int msb = std::bit_width(units) - 1;
+        units += (uint64_t(1) << (msb - SECOND_LEVEL_BITS)) - 1;
+        msb = std::bit_width(units) - 1;
+        units &= ~((uint64_t(1) << (msb - SECOND_LEVEL_BITS)) - 1);
+    }
+    return static_cast<GLsizeiptr>(units) * GRANULE;
+}
+
+int GpuAllocator::newBlock() {
+    if (!unused_blocks.empty()) {
+        int block = unused_blocks.back();
+        unused_blocks.pop_back();
+        blocks[block] = Block();
+        return block;
+    }
+    blocks.emplace_back();
+    return static_cast<int>(blocks.size()) - 1;
+}
+
+void GpuAllocator::releaseBlock(int block) {
+    blocks[block].pool = -1;
+    unused_blocks.push_back(block);
+}
+
+void GpuAllocator::insertFree(int block) {
+    Block& b = blocks[block];
+    int first, second;
+    mapping(b.size, first, second);
+    b.free = true;
+    b.prev_free = -1;
+    b.next_free = heads[first][second];
+    if (b.next_free >= 0) blocks[b.next_free].prev_free = block;
+    heads[first][second] = block;
+    first_level_bitmap |= uint64_t(1) << first;
+    second_level_bitmap[first] |= 1u << second;
+}
+
+void GpuAllocator::removeFree(int block) {
+    Block& b = blocks[block];
+    int first, second;
+    mapping(b.size, first, second);
+    if (b.prev_free >= 0) blocks[b.prev_free].next_free = b.next_free;
+    else heads[first][second] = b.next_free;
+    if (b.next_free >= 0) blocks[b.next_free].prev_free = b.prev_free;
+    if (heads[first][second] < 0) {
+        second_level_bitmap[first] &= ~(1u << second);
+        if (second_level_bitmap[first] == 0) first_level_bitmap &= ~(uint64_t(1) << first);
+    }
+    b.free = false;
+    b.prev_free = b.next_free = -1;
+}
+
+int GpuAllocator::findFree(GLsizeiptr size) {
+    int first, second;
+    mapping(searchSize(size), first, second);
+    if (first >= FIRST_LEVELS) {
+        return -1;
+    }
+    uint32_t second_map = second_level_bitmap[first] & (~0u << second);
+    if (second_map == 0) {
+        uint64_t first_map = first + 1 < 64 ? first_level_bitmap & (~uint64_t(0) << (first + 1)) : 0;
+        if (first_map == 0) {
+            return -1;
+        }
+        first = std::countr_zero(first_map);
+        second_map = second_level_bitmap[first];
+    }
+    return heads[first][std::countr_zero(second_map)];
+}
+
+int GpuAllocator::split(int block, GLsizeiptr size) {
+    int tail = newBlock();
+    Block& b = blocks[block];
+    Block& t = blocks[tail];
+    t.offset = b.offset + size;
+    t.size = b.size - size;
+    t.pool = b.pool;
+    t.prev_physical = block;
+    t.next_physical = b.next_physical;
+    if (t.next_physical >= 0) blocks[t.next_physical].prev_physical = tail;
+    b.next_physical = tail;
+    b.size = size;
+    return tail;
+}
+
+int GpuAllocator::place(int block, GLsizeiptr size) {
+    removeFree(block);
+    GLsizeiptr gap = alignUp(blocks[block].offset, getAlignment()) - blocks[block].offset;
+    if (gap > 0) {
+        int aligned = split(block, gap);
+        insertFree(block); // the neighbours of a free block are used, nothing to merge
+        block = aligned;
+    }
+    if (blocks[block].size - size >= GRANULE) {
+        insertFree(split(block, size));
+    }
+    blocks[block].free = false;
+    return block;
+}
+
+void GpuAllocator::mergeFree(int block) {
+    int prev = blocks[block].prev_physical;
+    if (prev >= 0 && blocks[prev].free) {
+        removeFree(prev);
+        blocks[prev].size += blocks[block].size;
+        blocks[prev].next_physical = blocks[block].next_physical;
+        if (blocks[prev].next_physical >= 0) blocks[blocks[prev].next_physical].prev_physical = prev;
+        releaseBlock(block);
+        block = prev;
+    }
+    int next = blocks[block].next_physical;
+    if (next >= 0 && blocks[next].free) {
+        removeFree(next);
+        blocks[block].size += blocks[next].size;
+        blocks[block].next_physical = blocks[next].next_physical;
+        if (blocks[block].next_physical >= 0) blocks[blocks[block].next_physical].prev_physical = block;
+        releaseBlock(next);
+    }
+    insertFree(block);
+}
+
+void GpuAllocator::addPool(GLsizeiptr min_size) {
+    Pool pool;
+    pool.size = std::max(alignUp(pool_size, GRANULE), searchSize(min_size));
+    glCreateBuffers(1, &pool.buffer);
+    glNamedBufferStorage(pool.buffer, pool.size, nullptr, storage_flags);
+    pools.push_back(pool);
+
+    int block = newBlock();
+    blocks[block].size = pool.size;
+    blocks[block].pool = static_cast<int>(pools.size()) - 1;
+    insertFree(block);
+}
+
+GpuAllocator::Allocation GpuAllocator::allocate(GLsizeiptr size) {
+    if (size <= 0) {
+        return {};
+    }
+    // room for the worst alignment gap, free blocks always start at a GRANULE multiple
+    GLsizeiptr needed = alignUp(size, GRANULE);
+    GLsizeiptr search = needed + getAlignment() - GRANULE;
+    int block = findFree(search);
+    if (block < 0) {
+        addPool(search);
+        block = findFree(search);
+    }
+    block = place(block, needed);
+    blocks[block].requested = size;
+    allocation_count++;
+    return { pools[blocks[block].pool].buffer, blocks[block].offset, size, block };
+}
+
+void GpuAllocator::free(Allocation& allocation) {
+    if (!allocation) {
+        return;
+    }
+    mergeFree(allocation.block);
+    allocation_count--;
+    allocation = {};
+}
+
+size_t GpuAllocator::defragment(const MoveCallback& on_move, size_t max_moves) {
+    auto lower = [&](int a, int b) {
+        return blocks[a].pool != blocks[b].pool ? blocks[a].pool < blocks[b].pool : blocks[a].offset < blocks[b].offset;
+    };
+    std::vector<int> used;
+    for (int i = 0; i < static_cast<int>(blocks.size()); ++i) {
+        if (blocks[i].pool >= 0 && !blocks[i].free) used.push_back(i);
+    }
+    std::sort(used.begin(), used.end(), [&](int a, int b) { return lower(b, a); }); // highest first
+
+    size_t moved = 0;
+    for (int block : used) {
+        if (moved >= max_moves) break;
+        // lowest free block that fits (not O(1), defragmentation is a maintenance step)
+        GLsizeiptr needed = blocks[block].size;
+        int target = -1;
+        for (int i = 0; i < static_cast<int>(blocks.size()); ++i) {
+            const Block& b = blocks[i];
+            if (b.pool < 0 || !b.free) continue;
+            if (alignUp(b.offset, getAlignment()) + needed > b.offset + b.size) continue;
+            if (target < 0 || lower(i, target)) target = i;
+        }
+        if (target < 0 || !lower(target, block)) continue;
+
+        target = place(target, needed);
+        blocks[target].requested = blocks[block].requested;
+        Allocation from{ pools[blocks[block].pool].buffer, blocks[block].offset, blocks[block].requested, block };
+        Allocation to{ pools[blocks[target].pool].buffer, blocks[target].offset, blocks[target].requested, target };
+        glCopyNamedBufferSubData(from.buffer, to.buffer, from.offset, to.offset, from.size);
+        mergeFree(block);
+        on_move(from, to);
+        moved++;
+    }
+    return moved;
+}
+
+GpuAllocator::Stats GpuAllocator::getStats() const {
+    Stats stats;
+    stats.pools = pools.size();
+    for (const Pool& pool : pools) stats.capacity += pool.size;
+    for (const Block& block : blocks) {
+        if (block.pool < 0) continue;
+        if (block.free) {
+            stats.free_blocks++;
+            stats.largest_free = std::max(stats.largest_free, block.size);
+        }
+        else {
+            stats.used += block.size;
+        }
+    }
+    stats.allocations = allocation_count;
+    return stats;
+}
+
+void GpuAllocator::cleanup() {
+    for (Pool& pool : pools) glDeleteBuffers(1, &pool.buffer);
+    pools.clear();
+    blocks.clear();
+    unused_blocks.clear();
+    first_level_bitmap = 0;
+    std::fill(std::begin(second_level_bitmap), std::end(second_level_bitmap), 0u);
+    for (auto& level : heads) std::fill(std::begin(level), std::end(level), -1);
+    allocation_count = 0;
+}
+
+namespace gpu_memory {
+    GpuAllocator& vertices() {
+        static GpuAllocator allocator(GpuAllocator::Usage::Vertex, 64 << 20, sizeof(vertex));
+        return allocator;
+    }
+
+    GpuAllocator& indices() {
+        static GpuAllocator allocator(GpuAllocator::Usage::Index, 32 << 20);
+        return allocator;
+    }
+
+    StreamBuffer& stream() {
+        static StreamBuffer buffer(8 << 20);
+        return buffer;
+    }
+
+    GLsizeiptr bufferOffsetAlignment() {
+        static GLsizeiptr alignment = []() {
+            GLint ubo_alignment = 256, ssbo_alignment = 256;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_alignment);
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_alignment);
+            return static_cast<GLsizeiptr>(std::max(ubo_alignment, ssbo_alignment));
+        }();
+        return alignment;
+    }
+
+    void cleanup() {
+        vertices().cleanup();
+        indices().cleanup();
+        stream().cleanup();
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "StreamBuffer.hpp"
+
+// Suballocator of large immutable GL buffers (glNamedBufferStorage pools).
+// Free ranges are kept in a two-level segregated fit (TLSF) structure: a first level per power of two and
+// SECOND_LEVELS linear subdivisions of it, with bitmaps of the non-empty lists, so allocate() and free() are O(1).
+// Freed ranges are merged with free neighbours of the same pool. A new pool is created when no free range fits.
+// Offsets follow the alignment of the usage (vertex stride for base vertex draws, UBO / SSBO offset alignment).
+class GpuAllocator {
+public:
+    enum class Usage { Vertex, Index, Uniform, Storage };
+
+    struct Allocation {
+        GLuint buffer = 0;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;  // requested size
+        int block = -1;       // internal
+        explicit operator bool() const { return block >= 0; }
+    };
+
+    struct Stats {
+        size_t pools = 0;
+        GLsizeiptr capacity = 0;      // bytes in all pools
+        GLsizeiptr used = 0;          // bytes in allocated blocks, including alignment padding
+        size_t allocations = 0;
+        size_t free_blocks = 0;
+        GLsizeiptr largest_free = 0;
+    };
+
+    // element_size: vertex stride for Usage::Vertex (offsets must be multiples of it), otherwise ignored
+    GpuAllocator(Usage usage, GLsizeiptr pool_size, GLsizeiptr element_size = 1,
+        GLbitfield storage_flags = GL_DYNAMIC_STORAGE_BIT);
+    ~GpuAllocator() = default;
+    GpuAllocator(const GpuAllocator&) = delete;
+    GpuAllocator& operator=(const GpuAllocator&) = delete;
+
+    // Deletes the pools, every allocation becomes invalid
+    void cleanup();
+
+    // Empty allocation for size 0. Pools are created on demand, so a GL context must be current.
+    Allocation allocate(GLsizeiptr size);
+    void free(Allocation& allocation);
+
+    // Defragmentation hook: moves up to max_moves allocations from the end of the pools into free ranges
+    // at lower addresses (data copied with glCopyNamedBufferSubData). on_move(from, to) is called for each
+    // so the owner can update its handles and bindings. Returns the number of moved allocations.
+    using MoveCallback = std::function<void(const Allocation& from, const Allocation& to)>;
+    size_t defragment(const MoveCallback& on_move, size_t max_moves = SIZE_MAX);
+
+    Stats getStats() const;
+    GLsizeiptr getAlignment();
+
+private:
+    static constexpr GLsizeiptr GRANULE = 16;   // block sizes and offsets are multiples of it
+    static constexpr int SECOND_LEVEL_BITS = 4;
+    static constexpr int SECOND_LEVELS = 1 << SECOND_LEVEL_BITS;
+    static constexpr int FIRST_LEVELS = 40;
+
+    struct Block {
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+        GLsizeiptr requested = 0; // allocated blocks: size asked for
+        int pool = -1;            // -1 for recycled entries
+        int prev_physical = -1, next_physical = -1; // neighbours in the same pool
+        int prev_free = -1, next_free = -1;         // free list of the size class
+        bool free = false;
+    };
+    struct Pool {
+        GLuint buffer = 0;
+        GLsizeiptr size = 0;
+    };
+
+    Usage usage;
+    GLsizeiptr pool_size;
+    GLsizeiptr element_size;
+    GLbitfield storage_flags;
+    GLsizeiptr alignment = 0; // resolved on first use (needs GL limits)
+
+    std::vector<Pool> pools;
+    std::vector<Block> blocks;
+    std::vector<int> unused_blocks; // recycled entries of blocks
+    uint64_t first_level_bitmap = 0;
+    uint32_t second_level_bitmap[FIRST_LEVELS] = {};
+    int heads[FIRST_LEVELS][SECOND_LEVELS];
+    size_t allocation_count = 0;
+
+    static void mapping(GLsizeiptr size, int& first, int& second);
+    static GLsizeiptr searchSize(GLsizeiptr size); // rounded up to the next size class
+    int newBlock();
+    void releaseBlock(int block);
+    void insertFree(int block);
+    void removeFree(int block);
+    int findFree(GLsizeiptr size);
+    int split(int block, GLsizeiptr size); // returns the tail block (free, not inserted)
+    int place(int block, GLsizeiptr size); // allocates size bytes at the aligned start of a free block
+    void mergeFree(int block);
+    void addPool(GLsizeiptr min_size);
+};
+
+// Shared allocators, cleaned up by the application before the GL context goes away
+namespace gpu_memory {
+    GpuAllocator& vertices(); // Mesh vertex data (stride of vertex)
+    GpuAllocator& indices();  // Mesh index data
+    StreamBuffer& stream();   // per frame uniform / storage / indirect / vertex data
+    // Offset alignment that suits both UBO and SSBO bindings, queried once (needs a GL context)
+    GLsizeiptr bufferOffsetAlignment();
+    void cleanup();
+}
@@ -0,0 +1,307 @@
+#include "HiZCuller.hpp"
+#include "GLState.hpp"
+#include "InstancedRenderer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <iostream>
+
+void HiZCuller::init(const std::vector<Model*>& objects, ShaderProgram& shader) {
+    cull_program = ShaderProgram("resources/shaders/hiz_cull.comp");
+    build_program = ShaderProgram("resources/shaders/hiz_build.comp");
+    phase_uniform = cull_program.uniform("uPhase");
+    object_count_uniform = cull_program.uniform("uObjectCount");
+    levels_uniform = cull_program.uniform("uHiZLevels");
+    level_uniform = build_program.uniform("uLevel");
+    instanced_uniform = shader.uniform("uInstanced");
+    tex0_uniform = shader.uniform("tex0");
+
+    // Merge all meshes into one buffer pair, every mesh becomes one draw command template
+    // with the bounds of its model and an Instance record carrying its material
+    struct MergedMesh {
+        GpuObject object;
+        GLuint material;
+        std::tuple<GLint, GLuint64, GLuint> source; // texture array, handle, bound texture
+    };
+    std::vector<vertex> vertices;
+    std::vector<GLuint> indices;
+    std::vector<MergedMesh> merged;
+    for (Model* model : objects) {
+        glm::mat4 m = model->getModelMatrix();
+        glm::mat3 normal_matrix = glm::mat3(glm::transpose(glm::inverse(m)));
+        glm::vec3 bmin, bmax;
+        model->getWorldBounds(bmin, bmax);
+
+        for (const auto& mesh : model->meshes) {
+            if (mesh.primitive_type != GL_TRIANGLES || mesh.indices.empty()) continue;
+            GpuObject object{};
+            object.bmin = glm::vec4(bmin, 1.0f);
+            object.bmax = glm::vec4(bmax, 1.0f);
+            object.count = static_cast<GLuint>(mesh.indices.size());
+            object.first_index = static_cast<GLuint>(indices.size());
+            object.base_vertex = static_cast<GLint>(vertices.size());
+            object.visible = 1; // everything is drawn in phase 1 of the first frame
+            for (vertex v : mesh.vertices) {
+                v.position = glm::vec3(m * glm::vec4(v.position, 1.0f));
+                v.normal = glm::normalize(normal_matrix * v.normal);
+                vertices.push_back(v);
+            }
+            indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+
+            const Material& material = *mesh.material;
+            GLint array = material.texture_handle != 0 ? -1 : material.texture_array;
+            merged.push_back({ object, material.getIndex(), { array, material.texture_handle, material.getBoundTexture() } });
+        }
+    }
+    object_count = merged.size();
+    if (object_count == 0) {
+        return;
+    }
+
+    // objects of one batch get consecutive command slots
+    std::stable_sort(merged.begin(), merged.end(), [](const MergedMesh& a, const MergedMesh& b) {
+        return a.source < b.source;
+    });
+    std::vector<GpuObject> gpu_objects;
+    std::vector<GpuInstance> records;
+    for (size_t i = 0; i < merged.size(); ++i) {
+        if (i == 0 || merged[i].source != merged[i - 1].source) {
+            batches.push_back({ static_cast<GLuint>(i), 0, std::get<2>(merged[i].source) });
+        }
+        Batch& batch = batches.back();
+        batch.count++;
+        GpuObject object = merged[i].object;
+        object.batch = static_cast<GLuint>(batches.size() - 1);
+        object.command_base = batch.first;
+        gpu_objects.push_back(object);
+
+        GpuInstance record{};
+        record.model = glm::mat4(1.0f); // baked into the vertices
+        for (int c = 0; c < 3; ++c) record.normal[c] = glm::vec4(glm::mat3(1.0f)[c], 0.0f);
+        record.material = merged[i].material;
+        records.push_back(record);
+    }
+
+    glCreateVertexArrays(1, &VAO);
+    glCreateBuffers(1, &VBO);
+    glNamedBufferData(VBO, vertices.size() * sizeof(vertex), vertices.data(), GL_STATIC_DRAW);
+    glCreateBuffers(1, &EBO);
+    glNamedBufferData(EBO, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+    // Same attribute setup as Mesh
+    GLint position_attrib_location = shader.getAttribLocation("aPos");
+    if (position_attrib_location >= 0) {
+        glEnableVertexArrayAttrib(VAO, position_attrib_location);
+        glVertexArrayAttribFormat(VAO, position_attrib_location, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, position));
+        glVertexArrayAttribBinding(VAO, position_attrib_location, 0);
+    }
+    GLint normal_attrib_location = shader.getAttribLocation("aNorm");
+    if (normal_attrib_location >= 0) {
+        glEnableVertexArrayAttrib(VAO, normal_attrib_location);
+        glVertexArrayAttribFormat(VAO, normal_attrib_location, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, normal));
+        glVertexArrayAttribBinding(VAO, normal_attrib_location, 0);
+    }
+    GLint tex_attrib_location = shader.getAttribLocation("aTex");
+    if (tex_attrib_location >= 0) {
+        glEnableVertexArrayAttrib(VAO, tex_attrib_location);
+        glVertexArrayAttribFormat(VAO, tex_attrib_location, 2, GL_FLOAT, GL_FALSE, offsetof(vertex, texCoord));
+        glVertexArrayAttribBinding(VAO, tex_attrib_location, 0);
+    }
+    glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(vertex));
+    glVertexArrayElementBuffer(VAO, EBO);
+
+    glCreateBuffers(1, &object_buffer);
+    glNamedBufferData(object_buffer, gpu_objects.size() * sizeof(GpuObject), gpu_objects.data(), GL_DYNAMIC_COPY);
+    glCreateBuffers(1, &instance_buffer);
+    glNamedBufferData(instance_buffer, records.size() * sizeof(GpuInstance), records.data(), GL_STATIC_DRAW);
+    glCreateBuffers(1, &command_buffer);
+    glNamedBufferData(command_buffer, object_count * sizeof(DrawCommand), nullptr, GL_DYNAMIC_COPY);
+    glCreateBuffers(1, &draw_count_buffer);
+    glNamedBufferData(draw_count_buffer, batches.size() * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glCreateBuffers(1, &counter_buffer);
+    glNamedBufferData(counter_buffer, 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glCreateBuffers(READBACK_FRAMES, readback_buffers);
+    for (GLuint buffer : readback_buffers) {
+        glNamedBufferData(buffer, 2 * sizeof(GLuint), nullptr, GL_STREAM_READ);
+    }
+
+    std::cout << "HiZCuller: " << object_count << " objects in " << batches.size() << " batches, "
+        << indices.size() / 3 << " triangles"
+        << (GLEW_ARB_indirect_parameters ? ", GPU draw count" : "") << std::endl;
+}
+
+void HiZCuller::resize(int width, int height) {
+    glDeleteFramebuffers(1, &depth_fbo);
+    gl_state::deleteTextures(1, &depth_texture);
+    gl_state::deleteTextures(1, &hiz_texture);
+
+    hiz_width = width;
+    hiz_height = height;
+    hiz_levels = 1 + static_cast<int>(std::floor(std::log2(static_cast<float>(std::max(width, height)))));
+
+    // Format has to match the target framebuffer for the depth blit
+    glCreateTextures(GL_TEXTURE_2D, 1, &depth_texture);
+    glTextureStorage2D(depth_texture, 1, GL_DEPTH24_STENCIL8, width, height);
+    glCreateFramebuffers(1, &depth_fbo);
+    glNamedFramebufferTexture(depth_fbo, GL_DEPTH_STENCIL_ATTACHMENT, depth_texture, 0);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &hiz_texture);
+    glTextureStorage2D(hiz_texture, hiz_levels, GL_R32F, width, height);
+    glTextureParameteri(hiz_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(hiz_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void HiZCuller::render(ShaderProgram& shader) {
+    if (!isReady()) {
+        return;
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (viewport[2] <= 0 || viewport[3] <= 0) {
+        return;
+    }
+    if (viewport[2] != hiz_width || viewport[3] != hiz_height) {
+        resize(viewport[2], viewport[3]);
+    }
+    GLint target_fbo = 0; // default framebuffer or the G-buffer
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_fbo);
+
+    GLuint zero = 0;
+    glClearNamedBufferData(counter_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    cullPhase(1);
+    drawPhase(shader);
+
+    // resolve the depth of phase 1 and build the pyramid from it
+    glBlitNamedFramebuffer(static_cast<GLuint>(target_fbo), depth_fbo, 0, 0, hiz_width, hiz_height, 0, 0, hiz_width, hiz_height,
+        GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    buildHiZ();
+
+    cullPhase(2);
+    drawPhase(shader);
+
+    // Counters go to a readback buffer that is read once its fence has passed
+    int slot = frame % READBACK_FRAMES;
+    if (readback_fences[slot]) glDeleteSync(readback_fences[slot]);
+    glCopyNamedBufferSubData(counter_buffer, readback_buffers[slot], 0, 0, 2 * sizeof(GLuint));
+    readback_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame++;
+    readStats();
+}
+
+void HiZCuller::cullPhase(int phase) {
+    GLuint zero = 0;
+    glClearNamedBufferData(command_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glClearNamedBufferData(draw_count_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    cull_program.activate();
+    cull_program.setUniform(phase_uniform, phase);
+    cull_program.setUniform(object_count_uniform, static_cast<int>(object_count));
+    cull_program.setUniform(levels_uniform, hiz_levels);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, object_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, command_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COUNTS_BINDING, draw_count_buffer);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, counter_buffer);
+    gl_state::bindTextureUnit(0, hiz_texture);
+
+    glDispatchCompute(static_cast<GLuint>((object_count + 63) / 64), 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+}
+
+void HiZCuller::drawPhase(ShaderProgram& shader) {
+    // base instance of every command is its object, tex.vert reads the object's record
+    shader.activate();
+    shader.setUniform(instanced_uniform, 1);
+    shader.setUniform(tex0_uniform, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, InstancedRenderer::INSTANCES_BINDING, instance_buffer);
+
+    gl_state::bindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    if (GLEW_ARB_indirect_parameters) {
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, draw_count_buffer);
+    }
+    for (size_t b = 0; b < batches.size(); ++b) {
+        const Batch& batch = batches[b];
+        if (batch.texture != 0) {
+            gl_state::bindTextureUnit(0, batch.texture);
+        }
+        const void* commands = reinterpret_cast<const void*>(batch.first * sizeof(DrawCommand));
+        if (GLEW_ARB_indirect_parameters) {
+            // the draw count written by the compute shader is read directly by the GPU
+            glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, commands,
+                static_cast<GLintptr>(b * sizeof(GLuint)), static_cast<GLsizei>(batch.count), 0);
+        }
+        else {
+            // unused commands are zero (count 0), they draw nothing
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commands, static_cast<GLsizei>(batch.count), 0);
+        }
+    }
+    if (GLEW_ARB_indirect_parameters) {
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    shader.setUniform(instanced_uniform, 0);
+}
+
+void HiZCuller::buildHiZ() {
+    build_program.activate();
+    gl_state::bindTextureUnit(0, depth_texture);
+    int w = hiz_width, h = hiz_height;
+    for (int level = 0; level < hiz_levels; ++level) {
+        build_program.setUniform(level_uniform, level);
+        if (level > 0) {
+            glBindImageTexture(0, hiz_texture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        }
+        glBindImageTexture(1, hiz_texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void HiZCuller::readStats() {
+    // oldest slot, written READBACK_FRAMES - 1 frames ago
+    int slot = frame % READBACK_FRAMES;
+    if (!readback_fences[slot]) {
+        return;
+    }
+    if (glClientWaitSync(readback_fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) {
+        return; // not finished yet, keep the previous numbers
+    }
+    GLuint counters[2];
+    glGetNamedBufferSubData(readback_buffers[slot], 0, sizeof(counters), counters);
+    frustum_culled = counters[0];
+    occlusion_culled = counters[1];
+    glDeleteSync(readback_fences[slot]);
+    readback_fences[slot] = nullptr;
+}
+
+void HiZCuller::cleanup() {
+    for (int i = 0; i < READBACK_FRAMES; ++i) {
+        if (readback_fences[i]) glDeleteSync(readback_fences[i]);
+        readback_fences[i] = nullptr;
+    }
+    glDeleteBuffers(READBACK_FRAMES, readback_buffers);
+    glDeleteBuffers(1, &counter_buffer);
+    glDeleteBuffers(1, &draw_count_buffer);
+    glDeleteBuffers(1, &command_buffer);
+    glDeleteBuffers(1, &instance_buffer);
+    glDeleteBuffers(1, &object_buffer);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &VBO);
+    gl_state::deleteVertexArrays(1, &VAO);
+    glDeleteFramebuffers(1, &depth_fbo);
+    gl_state::deleteTextures(1, &depth_texture);
+    gl_state::deleteTextures(1, &hiz_texture);
+    cull_program.clear();
+    build_program.clear();
+    VAO = VBO = EBO = object_buffer = instance_buffer = command_buffer = draw_count_buffer = counter_buffer = 0;
+    depth_fbo = depth_texture = hiz_texture = 0;
+    hiz_width = hiz_height = hiz_levels = 0;
+    object_count = 0;
+    batches.clear();
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Model.hpp"
+#include "ShaderProgram.hpp"
+
+// GPU occlusion culling of static objects (the maze wall chunks).
+// Their geometry is merged into one vertex / index buffer and drawn with indirect multi-draws in two phases:
+//  1. objects visible last frame are drawn (after a frustum test done in a compute shader),
+//  2. the depth is resolved into a hierarchical-Z pyramid and all objects are tested against it,
+//     objects that became visible (disocclusion) are drawn, visibility is stored for the next frame.
+// Every mesh becomes one object with a static Instance record (material index, world space already baked in).
+// Objects are grouped into batches by texture source, commands are compacted on the GPU into the range of
+// their batch and every batch is one multi-draw, so the texture array index stays dynamically uniform.
+// Culled counts come back through an atomic counter buffer read a few frames later, so the CPU never waits
+// on the GPU.
+class HiZCuller {
+public:
+    // Geometry of the objects is baked into world space, they must not move afterwards
+    void init(const std::vector<Model*>& objects, ShaderProgram& shader);
+    void cleanup();
+
+    // Draws the visible objects with shader, culled with the view projection of the Frame block (FrameUniforms)
+    void render(ShaderProgram& shader);
+
+    bool isReady() const { return object_count > 0 && cull_program.getID() != 0; }
+    size_t getObjectCount() const { return object_count; }
+    // Results of an older frame (latency of READBACK_FRAMES)
+    unsigned getFrustumCulled() const { return frustum_culled; }
+    unsigned getOcclusionCulled() const { return occlusion_culled; }
+
+private:
+    // Must match the Object struct in hiz_cull.comp (std430)
+    struct GpuObject {
+        glm::vec4 bmin;
+        glm::vec4 bmax;
+        GLuint count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint visible;
+        GLuint batch;
+        GLuint command_base;
+        GLuint padding[2];
+    };
+    struct DrawCommand {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+    };
+    // Objects of one texture source, commands first .. first + count - 1
+    struct Batch {
+        GLuint first;
+        GLuint count;
+        GLuint texture; // Material::getBoundTexture()
+    };
+    static constexpr GLuint DRAW_COUNTS_BINDING = 4; // storage block DrawCounts in hiz_cull.comp
+    static constexpr int READBACK_FRAMES = 3;
+
+    ShaderProgram cull_program;
+    ShaderProgram build_program;
+    ShaderProgram::UniformHandle phase_uniform, object_count_uniform, levels_uniform;
+    ShaderProgram::UniformHandle level_uniform;
+    ShaderProgram::UniformHandle instanced_uniform, tex0_uniform; // of the draw shader
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLuint object_buffer = 0;
+    GLuint instance_buffer = 0;
+    GLuint command_buffer = 0;
+    GLuint draw_count_buffer = 0;
+    GLuint counter_buffer = 0;
+    GLuint readback_buffers[READBACK_FRAMES] = {};
+    GLsync readback_fences[READBACK_FRAMES] = {};
+    int frame = 0;
+    std::vector<Batch> batches;
+    size_t object_count = 0;
+
+    // Single sampled copy of the depth buffer and the pyramid built from it
+    GLuint depth_fbo = 0;
+    GLuint depth_texture = 0;
+    GLuint hiz_texture = 0;
+    int hiz_width = 0;
+    int hiz_height = 0;
+    int hiz_levels = 0;
+
+    unsigned frustum_culled = 0;
+    unsigned occlusion_culled = 0;
+
+    void resize(int width, int height);
+    void cullPhase(int phase);
+    void drawPhase(ShaderProgram& shader);
+    void buildHiZ();
+    void readStats();
+};
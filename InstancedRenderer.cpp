@@ -0,0 +1,71 @@
+#include "InstancedRenderer.hpp"
+#include <algorithm>
+#include "Parallel.hpp"
+
+void InstancedRenderer::init(ShaderProgram& shader) {
+    instanced_uniform = shader.uniform("uInstanced");
+}
+
+void InstancedRenderer::cleanup() {
+    groups.clear();
+    group_index.clear();
+}
+
+void InstancedRenderer::begin() {
+    for (Group& group : groups) group.matrices.clear();
+}
+
+void InstancedRenderer::add(const Model& model, const glm::mat4& model_matrix) {
+    for (const Mesh& mesh : model.meshes) {
+        GroupKey key{ mesh.getVAO(), mesh.material->getIndex() };
+        auto found = group_index.find(key);
+        if (found == group_index.end()) {
+            found = group_index.emplace(key, groups.size()).first;
+            groups.push_back({ &mesh, {} });
+        }
+        groups[found->second].matrices.push_back(model_matrix);
+    }
+}
+
+void InstancedRenderer::draw(ShaderProgram& shader) {
+    draw_calls = 0;
+    instance_count = 0;
+    for (const Group& group : groups) instance_count += group.matrices.size();
+    if (instance_count == 0) {
+        return;
+    }
+
+    // groups are laid out back to back in this frame's range of the stream buffer,
+    // the normal matrices are computed here once per instance
+    StreamBuffer::Allocation instance_memory = gpu_memory::stream().allocate(instance_count * sizeof(GpuInstance));
+    if (!instance_memory) {
+        return;
+    }
+    GpuInstance* instances = static_cast<GpuInstance*>(instance_memory.data);
+    size_t offset = 0;
+    for (const Group& group : groups) {
+        const glm::mat4* matrices = group.matrices.data();
+        GLuint material = group.mesh->material->getIndex();
+        GpuInstance* out = instances + offset;
+        parallel_for(0, static_cast<int>(group.matrices.size()), [&](int i) {
+            out[i].model = matrices[i];
+            glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(matrices[i])));
+            for (int c = 0; c < 3; ++c) out[i].normal[c] = glm::vec4(normal[c], 0.0f);
+            out[i].material = material;
+        }, 1024);
+        offset += group.matrices.size();
+    }
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INSTANCES_BINDING, instance_memory.buffer, instance_memory.offset, instance_memory.size);
+
+    shader.activate();
+    shader.setUniform(instanced_uniform, 1);
+    offset = 0;
+    for (const Group& group : groups) {
+        if (group.matrices.empty()) continue;
+        group.mesh->drawInstanced(static_cast<GLsizei>(group.matrices.size()), static_cast<GLuint>(offset));
+        offset += group.matrices.size();
+        draw_calls++;
+    }
+    shader.setUniform(instanced_uniform, 0);
+}
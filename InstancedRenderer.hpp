@@ -0,0 +1,59 @@
+#pragma once
+#include <GL/glew.h>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <glm/glm.hpp>
+#include "GpuAllocator.hpp"
+#include "Model.hpp"
+#include "ShaderProgram.hpp"
+
+// Per instance (or per draw) record of the Instances storage block in tex.vert (std430)
+struct GpuInstance {
+    glm::mat4 model;
+    glm::vec4 normal[3]; // mat3 columns padded to vec4
+    GLuint material;     // Material::getIndex()
+    GLuint padding[3];
+};
+static_assert(sizeof(GpuInstance) == 128, "GpuInstance must match the std430 Instance struct in tex.vert");
+
+// Hardware instancing of repeated meshes.
+// Instances added during the frame are grouped by mesh (VAO) and material; draw() packs the
+// world and normal matrices of all groups into one storage buffer and issues one instanced draw per group,
+// with the group's first record as base instance. tex.vert reads instances[gl_BaseInstance + gl_InstanceID]
+// when uInstanced is set.
+// Models sharing a mesh must be copies of one loaded Model (same VAO), separately loaded OBJs form separate groups.
+class InstancedRenderer {
+public:
+    static constexpr GLuint INSTANCES_BINDING = 7; // storage block Instances in tex.vert
+
+    void init(ShaderProgram& shader);
+    void cleanup();
+
+    // Starts a new frame, keeps the groups but forgets their instances
+    void begin();
+    // Queues every mesh of the model with the given world matrix
+    void add(const Model& model, const glm::mat4& model_matrix);
+    // Uploads the instance data and draws all groups with the shader, leaves uInstanced off
+    void draw(ShaderProgram& shader);
+
+    // Statistics of the last draw()
+    size_t getGroupCount() const { return draw_calls; }
+    size_t getInstanceCount() const { return instance_count; }
+
+private:
+    struct Group {
+        const Mesh* mesh = nullptr;
+        std::vector<glm::mat4> matrices;
+    };
+    // VAO, material index
+    using GroupKey = std::tuple<GLuint, GLuint>;
+
+    std::map<GroupKey, size_t> group_index;
+    std::vector<Group> groups;
+
+    ShaderProgram::UniformHandle instanced_uniform;
+
+    size_t draw_calls = 0;
+    size_t instance_count = 0;
+};
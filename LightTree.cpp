@@ -0,0 +1,163 @@
+#include "LightTree.hpp"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <queue>
+
+static bool sameLight(const PointLight& a, const PointLight& b) {
+    return a.position == b.position && a.ambient == b.ambient && a.diffuse == b.diffuse && a.specular == b.specular &&
+        a.constant == b.constant && a.linear == b.linear && a.quadratic == b.quadratic;
+}
+
+void LightTree::setLeaf(Node& node, int light_index) {
+    const PointLight& light = lights[light_index];
+    node.bounds = AABB(light.position, light.position);
+    node.ambient = light.ambient;
+    node.diffuse = light.diffuse;
+    node.specular = light.specular;
+    node.intensity = brightestChannel(light.ambient, light.diffuse, light.specular);
+    node.representative = light_index;
+    node.min_attenuation = node.max_attenuation = glm::vec3(light.constant, light.linear, light.quadratic);
+    node.radius = light.influenceRadius();
+    node.light = light_index;
+}
+
+void LightTree::combine(Node& node) {
+    const Node& a = nodes[node.left];
+    const Node& b = nodes[node.right];
+    node.bounds = a.bounds;
+    node.bounds.expand(b.bounds);
+    node.ambient = a.ambient + b.ambient;
+    node.diffuse = a.diffuse + b.diffuse;
+    node.specular = a.specular + b.specular;
+    node.intensity = brightestChannel(node.ambient, node.diffuse, node.specular);
+    node.representative = a.intensity >= b.intensity ? a.representative : b.representative;
+    node.min_attenuation = glm::min(a.min_attenuation, b.min_attenuation);
+    node.max_attenuation = glm::max(a.max_attenuation, b.max_attenuation);
+    node.radius = std::min(a.radius, b.radius);
+}
+
+int LightTree::buildNode(int first, int count, int parent) {
+    int index = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    nodes[index].parent = parent;
+    if (count == 1) {
+        setLeaf(nodes[index], order[first]);
+        leaf_of_light[order[first]] = index;
+        return index;
+    }
+
+    // median split along the longest axis of the light positions
+    AABB extent = AABB::empty();
+    for (int i = first; i < first + count; ++i) {
+        extent.expand(AABB(lights[order[i]].position, lights[order[i]].position));
+    }
+    glm::vec3 size = extent.max - extent.min;
+    int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    int half = count / 2;
+    std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+        [&](int a, int b) { return lights[a].position[axis] < lights[b].position[axis]; });
+
+    int left = buildNode(first, half, index);
+    int right = buildNode(first + half, count - half, index);
+    nodes[index].left = left;
+    nodes[index].right = right;
+    combine(nodes[index]);
+    return index;
+}
+
+void LightTree::build() {
+    nodes.clear();
+    refits_since_build = 0;
+    if (lights.empty()) {
+        return;
+    }
+    nodes.reserve(2 * lights.size() - 1);
+    order.resize(lights.size());
+    std::iota(order.begin(), order.end(), 0);
+    leaf_of_light.assign(lights.size(), -1);
+    buildNode(0, static_cast<int>(lights.size()), -1);
+}
+
+void LightTree::update(const std::vector<PointLight>& new_lights) {
+    if (new_lights.size() != lights.size() || nodes.empty() || refits_since_build >= rebuild_interval) {
+        lights = new_lights;
+        build();
+        return;
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < new_lights.size(); ++i) {
+        if (sameLight(lights[i], new_lights[i])) continue;
+        lights[i] = new_lights[i];
+        Node& leaf = nodes[leaf_of_light[i]];
+        setLeaf(leaf, static_cast<int>(i));
+        for (int p = leaf.parent; p >= 0 && !nodes[p].dirty; p = nodes[p].parent) {
+            nodes[p].dirty = true;
+        }
+        changed = true;
+    }
+    if (!changed) {
+        return;
+    }
+    // children always have higher indices than their parent, one backward pass refits bottom-up
+    for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; --i) {
+        if (!nodes[i].dirty) continue;
+        combine(nodes[i]);
+        nodes[i].dirty = false;
+    }
+    refits_since_build++;
+}
+
+// The summed contribution of the node's lights at the camera lies between the intensity attenuated
+// over the nearest distance with the weakest falloff and over the farthest distance with the strongest one,
+// so does the contribution of the virtual light. Their difference bounds the aggregation error.
+float LightTree::errorBound(const Node& node, const glm::vec3& camera_position) const {
+    if (node.light >= 0) {
+        return 0.0f; // a single light is exact
+    }
+    if (glm::length(node.bounds.max - node.bounds.min) > max_merge_extent * node.radius) {
+        // too spread out for one position, surfaces near its lights would see a displaced hotspot
+        return std::numeric_limits<float>::max();
+    }
+    float nearest = glm::length(glm::clamp(camera_position, node.bounds.min, node.bounds.max) - camera_position);
+    float farthest = glm::length(glm::max(glm::abs(camera_position - node.bounds.min), glm::abs(camera_position - node.bounds.max)));
+    const glm::vec3& lo = node.min_attenuation;
+    const glm::vec3& hi = node.max_attenuation;
+    float brightest = 1.0f / (lo.x + lo.y * nearest + lo.z * nearest * nearest);
+    float darkest = 1.0f / (hi.x + hi.y * farthest + hi.z * farthest * farthest);
+    return node.intensity * (brightest - darkest);
+}
+
+void LightTree::selectCut(const glm::vec3& camera_position, std::vector<PointLight>& out) {
+    cut_size = 0;
+    cut_error = 0.0f;
+    if (nodes.empty()) {
+        return;
+    }
+
+    // refine the node with the largest error until all are below the target. Nodes too spread out to be
+    // merged at all (infinite error) are refined past max_cut_size, the cap only limits finite refinement.
+    constexpr float UNMERGEABLE = std::numeric_limits<float>::max();
+    using Entry = std::pair<float, int>;
+    std::priority_queue<Entry> cut;
+    cut.push({ errorBound(nodes[0], camera_position), 0 });
+    while (cut.top().first > error_target &&
+        (cut.top().first == UNMERGEABLE || static_cast<int>(cut.size()) < max_cut_size)) {
+        int index = cut.top().second;
+        cut.pop();
+        for (int child : { nodes[index].left, nodes[index].right }) {
+            cut.push({ errorBound(nodes[child], camera_position), child });
+        }
+    }
+
+    cut_size = cut.size();
+    cut_error = cut.top().first;
+    while (!cut.empty()) {
+        const Node& node = nodes[cut.top().second];
+        cut.pop();
+        const PointLight& representative = lights[node.representative];
+        out.emplace_back(representative.position, node.ambient, node.diffuse, node.specular,
+            representative.constant, representative.linear, representative.quadratic);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Lights.hpp"
+#include "SceneBVH.hpp"
+
+// Lightcuts style hierarchy over point lights. Every node aggregates the lights below it into one
+// virtual light: summed colors, placed at the representative (brightest) light and using its attenuation.
+// selectCut() picks per frame the nodes whose aggregation error, bounded at the camera position, is below
+// error_target and refines the others, so groups of distant lights are shaded as single lights.
+// The camera bound says nothing about the surfaces the lights reach, so a node is only ever merged when its
+// extent stays below max_merge_extent of the smallest influence radius below it: every receiver sees the
+// virtual light within that fraction of its reach from the true lights, distant walls included.
+class LightTree {
+public:
+    // Refits the nodes above the lights that changed, rebuilds when the light count changed
+    // or after rebuild_interval refits
+    void update(const std::vector<PointLight>& lights);
+    // Virtual lights of the cut for the viewer at camera_position, appended to out
+    void selectCut(const glm::vec3& camera_position, std::vector<PointLight>& out);
+
+    float error_target = ATTENUATION_CUTOFF; // max error of an aggregated node (color units at the camera)
+    float max_merge_extent = 0.25f;          // largest node diagonal, as a fraction of its smallest light radius
+    int max_cut_size = 256;                  // refinement stops here even if the error target is not met,
+                                             // nodes wider than max_merge_extent are split regardless
+    int rebuild_interval = 600;
+
+    size_t getNodeCount() const { return nodes.size(); }
+    size_t getCutSize() const { return cut_size; }
+    float getCutError() const { return cut_error; } // largest error bound left in the last cut
+
+private:
+    struct Node {
+        AABB bounds;
+        glm::vec3 ambient{ 0.0f }, diffuse{ 0.0f }, specular{ 0.0f }; // sums over the lights below
+        float intensity = 0.0f;      // brightest channel of the sums
+        int representative = -1;     // light whose position and attenuation the node uses
+        glm::vec3 min_attenuation{ 0.0f }; // smallest constant, linear, quadratic below (brightest falloff)
+        glm::vec3 max_attenuation{ 0.0f }; // largest ones (darkest falloff)
+        float radius = 0.0f;         // smallest influenceRadius() below
+        int left = -1;               // children, -1 for leaves
+        int right = -1;
+        int parent = -1;
+        int light = -1;              // leaves: light index
+        bool dirty = false;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<PointLight> lights;  // copy from the last update, to detect changes
+    std::vector<int> leaf_of_light;
+    std::vector<int> order;          // light indices, partitioned during the build
+    int refits_since_build = 0;
+
+    size_t cut_size = 0;
+    float cut_error = 0.0f;
+
+    void build();
+    int buildNode(int first, int count, int parent);
+    void setLeaf(Node& node, int light_index);
+    void combine(Node& node);
+    float errorBound(const Node& node, const glm::vec3& camera_position) const;
+};
@@ -1,5 +1,9 @@
 #include "Lights.hpp"
-#include <glm/gtc/type_ptr.hpp>
+#include "GpuAllocator.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <limits>
 
 DirectionalLight DirectionalLight::createDefault() {
     return DirectionalLight(
@@ -37,41 +41,51 @@ AmbientLight AmbientLight::createDefault(const glm::vec3& color) {
     return AmbientLight(color);
 }
 
-void DirectionalLight::apply(GLuint shaderID, int index) const {
-    std::string prefix = "dirLights[" + std::to_string(index) + "]";
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".direction").c_str()), 1, glm::value_ptr(direction));
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".ambient").c_str()), 1, glm::value_ptr(ambient));
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".diffuse").c_str()), 1, glm::value_ptr(diffuse));
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".specular").c_str()), 1, glm::value_ptr(specular));
+// Solves constant + linear * d + quadratic * d^2 = intensity / ATTENUATION_CUTOFF for d
+static float attenuationRange(float constant, float linear, float quadratic, const glm::vec3& ambient,
+    const glm::vec3& diffuse, const glm::vec3& specular) {
+    float c = constant - brightestChannel(ambient, diffuse, specular) / ATTENUATION_CUTOFF;
+    if (c >= 0.0f) {
+        return 0.0f; // never bright enough to be visible
+    }
+    if (quadratic > 0.0f) {
+        return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+    }
+    if (linear > 0.0f) {
+        return -c / linear;
+    }
+    return std::numeric_limits<float>::max(); // no falloff
 }
 
-void PointLight::apply(GLuint shaderID, int index) const {
-    std::string prefix = "pointLights[" + std::to_string(index) + "]";
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".position").c_str()), 1, glm::value_ptr(position));
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".ambient").c_str()), 1, glm::value_ptr(ambient));
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".diffuse").c_str()), 1, glm::value_ptr(diffuse));
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".specular").c_str()), 1, glm::value_ptr(specular));
-    glProgramUniform1f(shaderID, glGetUniformLocation(shaderID, (prefix + ".constant").c_str()), constant);
-    glProgramUniform1f(shaderID, glGetUniformLocation(shaderID, (prefix + ".linear").c_str()), linear);
-    glProgramUniform1f(shaderID, glGetUniformLocation(shaderID, (prefix + ".quadratic").c_str()), quadratic);
+float PointLight::influenceRadius() const {
+    return attenuationRange(constant, linear, quadratic, ambient, diffuse, specular);
 }
 
-void SpotLight::apply(GLuint shaderID, int index) const {
-    std::string prefix = "spotLights[" + std::to_string(index) + "]";
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".position").c_str()), 1, glm::value_ptr(position));
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".direction").c_str()), 1, glm::value_ptr(direction));
-    glProgramUniform1f(shaderID, glGetUniformLocation(shaderID, (prefix + ".cutOff").c_str()), cutOff);
-    glProgramUniform1f(shaderID, glGetUniformLocation(shaderID, (prefix + ".outerCutOff").c_str()), outerCutOff);
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".ambient").c_str()), 1, glm::value_ptr(ambient));
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".diffuse").c_str()), 1, glm::value_ptr(diffuse));
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, (prefix + ".specular").c_str()), 1, glm::value_ptr(specular));
-    glProgramUniform1f(shaderID, glGetUniformLocation(shaderID, (prefix + ".constant").c_str()), constant);
-    glProgramUniform1f(shaderID, glGetUniformLocation(shaderID, (prefix + ".linear").c_str()), linear);
-    glProgramUniform1f(shaderID, glGetUniformLocation(shaderID, (prefix + ".quadratic").c_str()), quadratic);
+float SpotLight::influenceRadius() const {
+    return attenuationRange(constant, linear, quadratic, ambient, diffuse, specular);
 }
 
-void AmbientLight::apply(GLuint shaderID, int /*index*/) const {
-    glProgramUniform3fv(shaderID, glGetUniformLocation(shaderID, "ambientLight.color"), 1, glm::value_ptr(color));
+glm::vec4 SpotLight::boundingSphere() const {
+    float range = influenceRadius();
+    // for cones narrower than 90 degrees the sphere through the apex and the rim is smaller than the full range
+    if (outerCutOff > 0.70710678f) {
+        float radius = range / (2.0f * outerCutOff);
+        return glm::vec4(position + glm::normalize(direction) * radius, radius);
+    }
+    return glm::vec4(position, range);
+}
+
+GpuDirectionalLight DirectionalLight::pack() const {
+    return { direction, 0.0f, ambient, 0.0f, diffuse, 0.0f, specular, 0.0f };
+}
+
+GpuPointLight PointLight::pack() const {
+    return { position, constant, ambient, linear, diffuse, quadratic, specular, influenceRadius() };
+}
+
+GpuSpotLight SpotLight::pack() const {
+    return { position, constant, direction, linear, ambient, quadratic, diffuse, cutOff, specular, outerCutOff,
+        influenceRadius(), { 0.0f, 0.0f, 0.0f } };
 }
 
 void Lights::initDirectionalLight() {
@@ -90,15 +104,78 @@ void Lights::initAmbientLight(const glm::vec3& color) {
     ambientLight = AmbientLight::createDefault(color);
 }
 
-void Lights::apply(GLuint shaderID) const {
-    glProgramUniform1i(shaderID, glGetUniformLocation(shaderID, "numPointLights"), static_cast<int>(pointLights.size()));
-    glProgramUniform1i(shaderID, glGetUniformLocation(shaderID, "numSpotLights"), static_cast<int>(spotLights.size()));
-    ambientLight.apply(shaderID, 0);
-    sun.apply(shaderID, 0);
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void Lights::reserve(size_t point_count, size_t spot_count) {
+    if (buffer != 0 && point_count <= point_capacity && spot_count <= spot_capacity) {
+        return;
+    }
+    point_capacity = std::max<size_t>({ point_capacity * 2, point_count, 16 });
+    spot_capacity = std::max<size_t>({ spot_capacity * 2, spot_count, 16 });
+
+    size_t alignment = static_cast<size_t>(gpu_memory::bufferOffsetAlignment());
+    point_offset = alignUp(sizeof(GpuLightHeader), alignment);
+    spot_offset = alignUp(point_offset + point_capacity * sizeof(GpuPointLight), alignment);
+    buffer_size = spot_offset + spot_capacity * sizeof(GpuSpotLight);
+
+    glDeleteBuffers(1, &buffer);
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, buffer_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    staging.assign(buffer_size, std::byte{ 0 });
+    uploaded.clear(); // forces a full upload
+}
+
+void Lights::upload() {
+    reserve(pointLights.size(), spotLights.size());
+
+    GpuLightHeader header{};
+    header.sun = sun.pack();
+    header.ambient_color = ambientLight.color;
+    header.point_light_count = static_cast<GLint>(pointLights.size());
+    header.spot_light_count = static_cast<GLint>(spotLights.size());
+    std::memcpy(staging.data(), &header, sizeof(header));
+    auto* points = reinterpret_cast<GpuPointLight*>(staging.data() + point_offset);
     for (size_t i = 0; i < pointLights.size(); ++i) {
-        pointLights[i].apply(shaderID, i);
+        points[i] = pointLights[i].pack();
     }
+    auto* spots = reinterpret_cast<GpuSpotLight*>(staging.data() + spot_offset);
     for (size_t i = 0; i < spotLights.size(); ++i) {
-        spotLights[i].apply(shaderID, i);
+        spots[i] = spotLights[i].pack();
+    }
+
+    // dirty range = first to last byte that differs from what the buffer holds
+    size_t first = 0, last = buffer_size;
+    if (uploaded.size() == staging.size()) {
+        auto front = std::mismatch(staging.begin(), staging.end(), uploaded.begin());
+        first = static_cast<size_t>(front.first - staging.begin());
+        if (first < buffer_size) {
+            auto back = std::mismatch(staging.rbegin(), staging.rend(), uploaded.rbegin());
+            last = buffer_size - static_cast<size_t>(back.first - staging.rbegin());
+        }
+        else {
+            last = first; // nothing changed
+        }
+    }
+    else {
+        uploaded.resize(buffer_size);
+    }
+    uploaded_bytes = last - first;
+    if (uploaded_bytes > 0) {
+        glNamedBufferSubData(buffer, first, uploaded_bytes, staging.data() + first);
+        std::memcpy(uploaded.data() + first, staging.data() + first, uploaded_bytes);
     }
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, HEADER_BINDING, buffer, 0, sizeof(GpuLightHeader));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, POINT_LIGHTS_BINDING, buffer, point_offset, point_capacity * sizeof(GpuPointLight));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, SPOT_LIGHTS_BINDING, buffer, spot_offset, spot_capacity * sizeof(GpuSpotLight));
+}
+
+void Lights::cleanup() {
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    point_capacity = spot_capacity = 0;
+    staging.clear();
+    uploaded.clear();
 }
\ No newline at end of file
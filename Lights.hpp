@@ -4,7 +4,53 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <vector>
-#include <string>
+#include <cstddef>
+
+// GPU layouts of the lights, must match the blocks in tex.frag.
+// vec3 members are followed by a float so the std140 / std430 layout has no hidden padding.
+struct GpuDirectionalLight {
+    glm::vec3 direction; float pad0;
+    glm::vec3 ambient; float pad1;
+    glm::vec3 diffuse; float pad2;
+    glm::vec3 specular; float pad3;
+};
+
+struct GpuLightHeader {
+    GpuDirectionalLight sun;
+    glm::vec3 ambient_color;
+    GLint point_light_count;
+    GLint spot_light_count;
+    GLint pad[3];
+};
+
+struct GpuPointLight {
+    glm::vec3 position; float constant;
+    glm::vec3 ambient; float linear;
+    glm::vec3 diffuse; float quadratic;
+    glm::vec3 specular; float radius; // influenceRadius(), the shaders fade the light out to zero there
+};
+
+struct GpuSpotLight {
+    glm::vec3 position; float constant;
+    glm::vec3 direction; float linear;
+    glm::vec3 ambient; float quadratic;
+    glm::vec3 diffuse; float cutOff;
+    glm::vec3 specular; float outerCutOff;
+    float radius; float pad[3];
+};
+
+static_assert(sizeof(GpuLightHeader) == 96, "GpuLightHeader must match the std140 LightHeader block");
+static_assert(sizeof(GpuPointLight) == 64, "GpuPointLight must match the std430 PointLight struct");
+static_assert(sizeof(GpuSpotLight) == 96, "GpuSpotLight must match the std430 SpotLight struct");
+
+// Light contributions below this fraction are not visible in an 8 bit framebuffer
+constexpr float ATTENUATION_CUTOFF = 1.0f / 256.0f;
+
+// Largest channel of the light colors, what ATTENUATION_CUTOFF and light importance are measured against
+inline float brightestChannel(const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular) {
+    glm::vec3 brightest = glm::max(ambient, glm::max(diffuse, specular));
+    return glm::max(brightest.x, glm::max(brightest.y, brightest.z));
+}
 
 struct DirectionalLight {
     glm::vec3 direction;
@@ -15,7 +61,7 @@ struct DirectionalLight {
     DirectionalLight(const glm::vec3& dir, const glm::vec3& amb, const glm::vec3& diff, const glm::vec3& spec)
         : direction(dir), ambient(amb), diffuse(diff), specular(spec) {
     }
-    void apply(GLuint shaderID, int index) const;
+    GpuDirectionalLight pack() const;
     static DirectionalLight createDefault();
 };
 
@@ -32,7 +78,9 @@ struct PointLight {
         float c, float l, float q)
         : position(pos), ambient(amb), diffuse(diff), specular(spec), constant(c), linear(l), quadratic(q) {
     }
-    void apply(GLuint shaderID, int index) const;
+    GpuPointLight pack() const;
+    // Distance at which the attenuated light drops below ATTENUATION_CUTOFF of its brightest channel
+    float influenceRadius() const;
     static PointLight createDefault(const glm::vec3& position, const glm::vec3& color);
 };
 
@@ -54,14 +102,16 @@ struct SpotLight {
         : position(pos), direction(dir), cutOff(cut), outerCutOff(outerCut),
         ambient(amb), diffuse(diff), specular(spec), constant(c), linear(l), quadratic(q) {
     }
-    void apply(GLuint shaderID, int index) const;
+    GpuSpotLight pack() const;
+    float influenceRadius() const;
+    // Smallest sphere around the lit part of the cone (center in xyz, radius in w)
+    glm::vec4 boundingSphere() const;
     static SpotLight createDefault(const glm::vec3& pos, const glm::vec3& dir);
 };
 
 struct AmbientLight {
     glm::vec3 color;
     AmbientLight(const glm::vec3& col) : color(col) {}
-    void apply(GLuint shaderID, int index) const;
     static AmbientLight createDefault(const glm::vec3& color);
 };
 
@@ -77,7 +127,33 @@ public:
     void initPointLight(const glm::vec3& position, const glm::vec3& color);
     void initSpotLight(const glm::vec3& pos, const glm::vec3& dir);
     void initAmbientLight(const glm::vec3& color);
-    void apply(GLuint shaderID) const;
+
+    // Packs all lights and uploads the bytes that changed since the last upload with one
+    // glNamedBufferSubData, then binds the header / point / spot light ranges of the buffer.
+    // The light fields above can be modified freely, changes are found by comparing the packed data.
+    void upload();
+    void cleanup();
+
+    // Bytes sent to the GPU by the last upload
+    size_t getUploadedBytes() const { return uploaded_bytes; }
+
+    static constexpr GLuint HEADER_BINDING = 1;       // uniform block LightHeader
+    static constexpr GLuint POINT_LIGHTS_BINDING = 2; // storage block PointLights
+    static constexpr GLuint SPOT_LIGHTS_BINDING = 3;  // storage block SpotLights
+
+private:
+    // One buffer holds [header | point lights | spot lights], each part aligned for binding its range
+    GLuint buffer = 0;
+    size_t point_capacity = 0;
+    size_t spot_capacity = 0;
+    size_t point_offset = 0;
+    size_t spot_offset = 0;
+    size_t buffer_size = 0;
+    std::vector<std::byte> staging;  // packed this frame
+    std::vector<std::byte> uploaded; // content of the buffer
+    size_t uploaded_bytes = 0;
+
+    void reserve(size_t point_count, size_t spot_count);
 };
 
 #endif
\ No newline at end of file
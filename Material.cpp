@@ -0,0 +1,79 @@
+#include "Material.hpp"
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+GpuMaterial Material::getRecord() const {
+    GpuMaterial record;
+    record.ambient = ambient;
+    record.diffuse = diffuse;
+    record.specular = glm::vec4(glm::vec3(specular), reflectivity);
+    record.texture_handle = texture_handle;
+    record.texture_array = texture_handle == 0 ? texture_array : -1;
+    record.texture_layer = texture_layer;
+    record.texture_rect = texture_rect;
+    return record;
+}
+
+namespace {
+    using Key = std::tuple<GLuint, float, float, float, float>; // texture, diffuse rgba
+
+    struct Library {
+        std::vector<std::shared_ptr<Material>> materials;
+        std::map<Key, size_t> index;
+        std::vector<GpuMaterial> records;
+        GLuint buffer = 0;
+        size_t capacity = 0; // records the buffer holds
+    };
+
+    Library& library() {
+        static Library instance;
+        return instance;
+    }
+}
+
+namespace materials {
+    std::shared_ptr<Material> get(const glm::vec4& diffuse, GLuint texture_id) {
+        Library& lib = library();
+        Key key{ texture_id, diffuse.x, diffuse.y, diffuse.z, diffuse.w };
+        auto found = lib.index.find(key);
+        if (found != lib.index.end()) {
+            return lib.materials[found->second];
+        }
+        auto material = std::make_shared<Material>(static_cast<GLuint>(lib.materials.size()));
+        material->diffuse = diffuse;
+        material->texture_id = texture_id;
+        lib.index.emplace(key, lib.materials.size());
+        lib.materials.push_back(material);
+        return material;
+    }
+
+    const std::vector<std::shared_ptr<Material>>& all() {
+        return library().materials;
+    }
+
+    void upload() {
+        Library& lib = library();
+        if (lib.materials.empty()) {
+            return;
+        }
+        lib.records.resize(lib.materials.size());
+        for (size_t i = 0; i < lib.materials.size(); ++i) {
+            lib.records[i] = lib.materials[i]->getRecord();
+        }
+        if (lib.records.size() > lib.capacity) {
+            lib.capacity = std::max<size_t>(lib.records.size(), 2 * lib.capacity);
+            glDeleteBuffers(1, &lib.buffer);
+            glCreateBuffers(1, &lib.buffer);
+            glNamedBufferStorage(lib.buffer, lib.capacity * sizeof(GpuMaterial), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        }
+        glNamedBufferSubData(lib.buffer, 0, lib.records.size() * sizeof(GpuMaterial), lib.records.data());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, lib.buffer);
+    }
+
+    void cleanup() {
+        Library& lib = library();
+        glDeleteBuffers(1, &lib.buffer);
+        lib = Library();
+    }
+}
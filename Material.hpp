@@ -0,0 +1,59 @@
+#pragma once
+#include <GL/glew.h>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Record of the Materials storage block in tex.vert (std430)
+struct GpuMaterial {
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;      // w: reflectivity
+    GLuint64 texture_handle;
+    GLint texture_array;     // -1 for bindless textures and textures outside of the arrays
+    GLint texture_layer;
+    glm::vec4 texture_rect;
+};
+static_assert(sizeof(GpuMaterial) == 80, "GpuMaterial must match the std430 Material struct in tex.vert");
+
+// Surface parameters and texture source shared by meshes. Every material owns a fixed slot of the material
+// buffer (getIndex()), draws pass just the index (uMaterial, or the Instance record of instanced and
+// multi-draws) and the shader reads the prebuilt record. Changes reach the GPU with materials::upload().
+// The textures belong to whoever loaded them.
+class Material {
+public:
+    explicit Material(GLuint index) : index(index) {}
+
+    glm::vec4 ambient{ 1.0f };
+    glm::vec4 diffuse{ 1.0f };
+    glm::vec4 specular{ 1.0f };
+    float reflectivity{ 1.0f };
+    GLuint texture_id{ 0 };
+    // Texture source set by TextureArrays, the draws use the first available:
+    // bindless handle, layer of a bound texture array, texture_id bound to unit 0
+    GLuint64 texture_handle{ 0 };
+    GLint texture_array{ -1 };
+    GLint texture_layer{ -1 };
+    // TextureAtlas: rectangle of the image in texture_id (uv offset, uv size), zero when the texture is not an atlas
+    glm::vec4 texture_rect{ 0.0f };
+
+    GLuint getIndex() const { return index; }
+    // Texture the draw has to bind to unit 0, 0 when the shader finds it through the record
+    GLuint getBoundTexture() const { return texture_handle == 0 && texture_array < 0 ? texture_id : 0; }
+    GpuMaterial getRecord() const;
+
+private:
+    GLuint index;
+};
+
+// Shared material library, cleaned up by the application before the GL context goes away
+namespace materials {
+    constexpr GLuint BINDING = 8; // Materials block of tex.vert
+
+    // Material with this diffuse color and texture, meshes asking for the same pair share one
+    std::shared_ptr<Material> get(const glm::vec4& diffuse = glm::vec4(1.0f), GLuint texture_id = 0);
+    const std::vector<std::shared_ptr<Material>>& all();
+    // Rebuilds the records of all materials and binds the buffer at BINDING
+    void upload();
+    void cleanup();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+#include <glm/glm.hpp>
+
+// Conventions of maze_map shared by every grid based subsystem.
+// Map cell (x, y) covers the world square [x, x + 1) x [y, y + 1) on the XZ plane.
+namespace maze {
+    constexpr uchar WALL = '#';
+    constexpr uchar FLOOR = '.';
+    constexpr float TILE_SIZE = 1.0f;
+    constexpr float WALL_HEIGHT = 25.0f;
+
+    // Cells outside of the map are treated as walls
+    inline bool isWall(const cv::Mat& map, int x, int y) {
+        if (x < 0 || y < 0 || x >= map.cols || y >= map.rows) {
+            return true;
+        }
+        return map.at<uchar>(y, x) == WALL;
+    }
+
+    inline glm::ivec2 worldToCell(const glm::vec3& pos) {
+        return glm::ivec2(static_cast<int>(std::floor(pos.x / TILE_SIZE)),
+            static_cast<int>(std::floor(pos.z / TILE_SIZE)));
+    }
+
+    inline glm::vec3 cellCenter(int x, int y, float height = 0.0f) {
+        return glm::vec3((x + 0.5f) * TILE_SIZE, height, (y + 0.5f) * TILE_SIZE);
+    }
+}
@@ -0,0 +1,146 @@
+#include "MazeMesher.hpp"
+#include "Maze.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+
+void MazeMesher::addQuad(ChunkGeometry& geometry, const glm::vec3 corners[4], const glm::vec2 uvs[4], const glm::vec3& normal) {
+    GLuint base = static_cast<GLuint>(geometry.vertices.size());
+    for (int i = 0; i < 4; ++i) {
+        geometry.vertices.emplace_back(corners[i], uvs[i], normal);
+        geometry.min_bounds = glm::min(geometry.min_bounds, corners[i]);
+        geometry.max_bounds = glm::max(geometry.max_bounds, corners[i]);
+    }
+
+    // Keep counter-clockwise winding as seen from the side the normal points to (back faces are culled)
+    glm::vec3 face_normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+    if (glm::dot(face_normal, normal) >= 0.0f) {
+        geometry.indices.insert(geometry.indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+    }
+    else {
+        geometry.indices.insert(geometry.indices.end(), { base, base + 2, base + 1, base, base + 3, base + 2 });
+    }
+    geometry.quads++;
+}
+
+MazeMesher::ChunkGeometry MazeMesher::meshChunk(const cv::Mat& maze_map, int x0, int y0, int chunk_size, float wall_height) {
+    ChunkGeometry geometry;
+    geometry.min_bounds = glm::vec3(FLT_MAX);
+    geometry.max_bounds = glm::vec3(-FLT_MAX);
+
+    const float T = maze::TILE_SIZE;
+    int x1 = std::min(x0 + chunk_size, maze_map.cols);
+    int y1 = std::min(y0 + chunk_size, maze_map.rows);
+    // Unlike maze::isWall, the outside of the map is open so the outer faces are generated too
+    auto solid = [&](int x, int y) {
+        return x >= 0 && y >= 0 && x < maze_map.cols && y < maze_map.rows && maze_map.at<uchar>(y, x) == maze::WALL;
+    };
+
+    // Wall tops: 2D greedy merge of wall cells into rectangles
+    int w = x1 - x0;
+    int h = y1 - y0;
+    std::vector<unsigned char> used(static_cast<size_t>(w) * h, 0);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            if (used[y * w + x] || !solid(x0 + x, y0 + y)) continue;
+
+            int run_w = 1;
+            while (x + run_w < w && !used[y * w + x + run_w] && solid(x0 + x + run_w, y0 + y)) run_w++;
+            int run_h = 1;
+            bool grow = true;
+            while (grow && y + run_h < h) {
+                for (int i = 0; i < run_w; ++i) {
+                    if (used[(y + run_h) * w + x + i] || !solid(x0 + x + i, y0 + y + run_h)) {
+                        grow = false;
+                        break;
+                    }
+                }
+                if (grow) run_h++;
+            }
+            for (int j = 0; j < run_h; ++j) {
+                for (int i = 0; i < run_w; ++i) {
+                    used[(y + j) * w + x + i] = 1;
+                }
+            }
+
+            float ax = (x0 + x) * T, az = (y0 + y) * T;
+            float bx = (x0 + x + run_w) * T, bz = (y0 + y + run_h) * T;
+            glm::vec3 corners[4] = { {ax, wall_height, az}, {bx, wall_height, az}, {bx, wall_height, bz}, {ax, wall_height, bz} };
+            glm::vec2 uvs[4] = { {0.0f, 0.0f}, {float(run_w), 0.0f}, {float(run_w), float(run_h)}, {0.0f, float(run_h)} };
+            addQuad(geometry, corners, uvs, glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+    }
+
+    // Wall sides: faces between a wall and an open cell, merged into runs along the face plane
+    float v_top = wall_height / T;
+    for (int x = x0; x < x1; ++x) {
+        for (int dir = -1; dir <= 1; dir += 2) {
+            float plane_x = (dir > 0 ? x + 1 : x) * T;
+            for (int y = y0; y < y1; ) {
+                if (!(solid(x, y) && !solid(x + dir, y))) { ++y; continue; }
+                int start = y;
+                while (y < y1 && solid(x, y) && !solid(x + dir, y)) ++y;
+                float az = start * T, bz = y * T;
+                glm::vec3 corners[4] = { {plane_x, 0.0f, az}, {plane_x, 0.0f, bz}, {plane_x, wall_height, bz}, {plane_x, wall_height, az} };
+                glm::vec2 uvs[4] = { {0.0f, v_top}, {float(y - start), v_top}, {float(y - start), 0.0f}, {0.0f, 0.0f} };
+                addQuad(geometry, corners, uvs, glm::vec3(float(dir), 0.0f, 0.0f));
+            }
+        }
+    }
+    for (int y = y0; y < y1; ++y) {
+        for (int dir = -1; dir <= 1; dir += 2) {
+            float plane_z = (dir > 0 ? y + 1 : y) * T;
+            for (int x = x0; x < x1; ) {
+                if (!(solid(x, y) && !solid(x, y + dir))) { ++x; continue; }
+                int start = x;
+                while (x < x1 && solid(x, y) && !solid(x, y + dir)) ++x;
+                float ax = start * T, bx = x * T;
+                glm::vec3 corners[4] = { {ax, 0.0f, plane_z}, {bx, 0.0f, plane_z}, {bx, wall_height, plane_z}, {ax, wall_height, plane_z} };
+                glm::vec2 uvs[4] = { {0.0f, v_top}, {float(x - start), v_top}, {float(x - start), 0.0f}, {0.0f, 0.0f} };
+                addQuad(geometry, corners, uvs, glm::vec3(0.0f, 0.0f, float(dir)));
+            }
+        }
+    }
+
+    if (geometry.vertices.empty()) {
+        geometry.min_bounds = geometry.max_bounds = glm::vec3(0.0f);
+    }
+    return geometry;
+}
+
+std::vector<Model*> MazeMesher::buildChunks(const cv::Mat& maze_map, ShaderProgram& shader, GLuint texture_id,
+    int chunk_size, float wall_height) {
+    int chunks_x = (maze_map.cols + chunk_size - 1) / chunk_size;
+    int chunks_y = (maze_map.rows + chunk_size - 1) / chunk_size;
+
+    // Meshing is CPU only and runs in parallel, GL buffers are created afterwards on this thread
+    std::vector<ChunkGeometry> geometry(static_cast<size_t>(chunks_x) * chunks_y);
+    parallel_for(0, chunks_x * chunks_y, [&](int c) {
+        geometry[c] = meshChunk(maze_map, (c % chunks_x) * chunk_size, (c / chunks_x) * chunk_size, chunk_size, wall_height);
+    }, 1);
+
+    std::vector<Model*> chunks;
+    size_t quads = 0;
+    size_t triangles = 0;
+    for (int c = 0; c < chunks_x * chunks_y; ++c) {
+        ChunkGeometry& g = geometry[c];
+        if (g.indices.empty()) continue;
+
+        Model* chunk = new Model();
+        chunk->name = "maze_chunk_" + std::to_string(c % chunks_x) + "_" + std::to_string(c / chunks_x);
+        chunk->shader = shader;
+        chunk->meshes.emplace_back(GL_TRIANGLES, shader, g.vertices, g.indices, glm::vec3(0.0f), glm::vec3(0.0f), texture_id);
+        chunk->local_min = g.min_bounds;
+        chunk->local_max = g.max_bounds;
+        chunk->occluder = true;
+        chunks.push_back(chunk);
+
+        quads += g.quads;
+        triangles += g.indices.size() / 3;
+    }
+
+    std::cout << "Maze walls: " << chunks.size() << " chunks, " << quads << " quads, "
+        << triangles << " triangles" << std::endl;
+    return chunks;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <glm/glm.hpp>
+#include "assets.hpp"
+#include "Maze.hpp"
+#include "Model.hpp"
+#include "ShaderProgram.hpp"
+
+// Turns the wall cells of maze_map into extruded wall geometry.
+// Coplanar faces are merged with greedy meshing (2D for the wall tops, 1D runs for the sides)
+// and the result is split into square chunks, each one a single static Model / draw call.
+class MazeMesher {
+public:
+    struct ChunkGeometry {
+        std::vector<vertex> vertices;
+        std::vector<GLuint> indices;
+        glm::vec3 min_bounds{ 0.0f };
+        glm::vec3 max_bounds{ 0.0f };
+        size_t quads = 0;
+    };
+
+    // CPU side only: geometry of the chunk starting at map cell (x0, y0)
+    static ChunkGeometry meshChunk(const cv::Mat& maze_map, int x0, int y0, int chunk_size, float wall_height);
+
+    // One Model per non-empty chunk, ready to be added to maze_walls
+    static std::vector<Model*> buildChunks(const cv::Mat& maze_map, ShaderProgram& shader, GLuint texture_id,
+        int chunk_size = 32, float wall_height = maze::WALL_HEIGHT);
+
+private:
+    static void addQuad(ChunkGeometry& geometry, const glm::vec3 corners[4], const glm::vec2 uvs[4], const glm::vec3& normal);
+};
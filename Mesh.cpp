@@ -2,6 +2,7 @@
 #include <GLFW/glfw3.h>
 
 #include "Mesh.hpp"
+#include "GLState.hpp"
 #include <iostream>
 
 Mesh::Mesh(GLenum primitive_type, ShaderProgram shader, std::vector<vertex> const& vertices,
@@ -13,22 +14,23 @@ Mesh::Mesh(GLenum primitive_type, ShaderProgram shader, std::vector<vertex> cons
     indices(indices),
     origin(origin),
     orientation(orientation),
-    texture_id(texture_id),
-    diffuse_material(1.0f, 1.0f, 1.0f, 1.0f) { // Výchozí bílá barva s plnou opacitou
+    material(materials::get(glm::vec4(1.0f), texture_id)) { // Výchozí bílá barva s plnou opacitou
     // Create VAO
     glCreateVertexArrays(1, &VAO);
 
-    // Create VBO and upload vertex data
-    glCreateBuffers(1, &VBO);
-    glNamedBufferData(VBO, vertices.size() * sizeof(vertex), vertices.data(), GL_STATIC_DRAW);
-
-    // Create EBO and upload index data
-    glCreateBuffers(1, &EBO);
-    glNamedBufferData(EBO, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    // Vertex and index data go to ranges of the shared buffers
+    vertex_allocation = gpu_memory::vertices().allocate(vertices.size() * sizeof(vertex));
+    if (vertex_allocation) {
+        glNamedBufferSubData(vertex_allocation.buffer, vertex_allocation.offset, vertex_allocation.size, vertices.data());
+    }
+    index_allocation = gpu_memory::indices().allocate(indices.size() * sizeof(GLuint));
+    if (index_allocation) {
+        glNamedBufferSubData(index_allocation.buffer, index_allocation.offset, index_allocation.size, indices.data());
+    }
 
     // Set up attributes
     // Vertex position
-    GLint position_attrib_location = glGetAttribLocation(shader.getID(), "aPos");
+    GLint position_attrib_location = shader.getAttribLocation("aPos");
     if (position_attrib_location >= 0) {
         glEnableVertexArrayAttrib(VAO, position_attrib_location);
         glVertexArrayAttribFormat(VAO, position_attrib_location, 3, GL_FLOAT, GL_FALSE,
@@ -37,7 +39,7 @@ Mesh::Mesh(GLenum primitive_type, ShaderProgram shader, std::vector<vertex> cons
     }
 
     // Vertex normal
-    GLint normal_attrib_location = glGetAttribLocation(shader.getID(), "aNorm");
+    GLint normal_attrib_location = shader.getAttribLocation("aNorm");
     if (normal_attrib_location >= 0) {
         glEnableVertexArrayAttrib(VAO, normal_attrib_location);
         glVertexArrayAttribFormat(VAO, normal_attrib_location, 3, GL_FLOAT, GL_FALSE,
@@ -46,7 +48,7 @@ Mesh::Mesh(GLenum primitive_type, ShaderProgram shader, std::vector<vertex> cons
     }
 
     // Texture coordinates
-    GLint tex_attrib_location = glGetAttribLocation(shader.getID(), "aTex");
+    GLint tex_attrib_location = shader.getAttribLocation("aTex");
     if (tex_attrib_location >= 0) {
         glEnableVertexArrayAttrib(VAO, tex_attrib_location);
         glVertexArrayAttribFormat(VAO, tex_attrib_location, 2, GL_FLOAT, GL_FALSE,
@@ -54,9 +56,21 @@ Mesh::Mesh(GLenum primitive_type, ShaderProgram shader, std::vector<vertex> cons
         glVertexArrayAttribBinding(VAO, tex_attrib_location, 0);
     }
 
-    // Link VAO with VBO and EBO
-    glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(vertex));
-    glVertexArrayElementBuffer(VAO, EBO);
+    // Link VAO with the buffer ranges, the index offset is passed to the draw calls
+    glVertexArrayVertexBuffer(VAO, 0, vertex_allocation.buffer, vertex_allocation.offset, sizeof(vertex));
+    glVertexArrayElementBuffer(VAO, index_allocation.buffer);
+
+    tex0_uniform = shader.uniform("tex0");
+    material_uniform = shader.uniform("uMaterial");
+}
+
+// The shader reads the material record by index, only textures that are neither bindless nor in an array need a bind
+void Mesh::applyMaterial() const {
+    if (GLuint texture = material->getBoundTexture()) {
+        gl_state::bindTextureUnit(0, texture);
+        shader.setUniform(tex0_uniform, 0);
+    }
+    shader.setUniform(material_uniform, static_cast<int>(material->getIndex()));
 }
 
 void Mesh::draw(glm::vec3 const& offset, glm::vec3 const& rotation) const {
@@ -65,31 +79,30 @@ void Mesh::draw(glm::vec3 const& offset, glm::vec3 const& rotation) const {
         return;
     }
 
-    // Activate texture if it exists
-    if (texture_id != 0) {
-        glBindTextureUnit(0, texture_id);
-        GLint tex_loc = glGetUniformLocation(shader.getID(), "tex0");
-        if (tex_loc >= 0) {
-            glUniform1i(tex_loc, 0);
-        }
-    }
+    applyMaterial();
+
+    // Draw the mesh
+    gl_state::bindVertexArray(VAO);
+    glDrawElements(primitive_type, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT,
+        reinterpret_cast<const void*>(index_allocation.offset));
+}
 
-    // Set diffuse_material in shader
-    GLint diffuse_color_loc = glGetUniformLocation(shader.getID(), "u_diffuse_color");
-    if (diffuse_color_loc >= 0) {
-        glUniform4fv(diffuse_color_loc, 1, glm::value_ptr(diffuse_material));
+void Mesh::drawInstanced(GLsizei instance_count, GLuint base_instance) const {
+    if (VAO == 0) {
+        std::cerr << "VAO not initialized!\n";
+        return;
     }
 
-    // Draw the mesh
-    glBindVertexArray(VAO);
-    glDrawElements(primitive_type, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    applyMaterial();
+
+    gl_state::bindVertexArray(VAO);
+    glDrawElementsInstancedBaseInstance(primitive_type, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT,
+        reinterpret_cast<const void*>(index_allocation.offset), instance_count, base_instance);
 }
+
 void Mesh::clear() {
-    if (texture_id != 0) {
-        glDeleteTextures(1, &texture_id);
-        texture_id = 0;
-    }
+    // the texture belongs to the material, which may be shared
+    material = materials::get();
 
     primitive_type = GL_POINT;
     vertices.clear();
@@ -98,15 +111,9 @@ void Mesh::clear() {
     orientation = glm::vec3(0.0f);
 
     if (VAO != 0) {
-        glDeleteVertexArrays(1, &VAO);
+        gl_state::deleteVertexArrays(1, &VAO);
         VAO = 0;
     }
-    if (VBO != 0) {
-        glDeleteBuffers(1, &VBO);
-        VBO = 0;
-    }
-    if (EBO != 0) {
-        glDeleteBuffers(1, &EBO);
-        EBO = 0;
-    }
+    gpu_memory::vertices().free(vertex_allocation);
+    gpu_memory::indices().free(index_allocation);
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include "ShaderProgram.hpp"
+#include "GpuAllocator.hpp"
+#include "Material.hpp"
 #include "assets.hpp"
 
 class Mesh {
@@ -14,6 +16,12 @@ public:
 
     // Methods
     void draw(glm::vec3 const& offset = glm::vec3(0.0f), glm::vec3 const& rotation = glm::vec3(0.0f)) const;
+    // Same state as draw(), instance_count copies (per-instance data is up to the caller, see InstancedRenderer)
+    void drawInstanced(GLsizei instance_count, GLuint base_instance = 0) const;
+    GLuint getVAO() const { return VAO; }
+    // Ranges of the shared vertex / index buffers (gpu_memory) holding the mesh
+    const GpuAllocator::Allocation& getVertexAllocation() const { return vertex_allocation; }
+    const GpuAllocator::Allocation& getIndexAllocation() const { return index_allocation; }
     void clear();
 
     // Public members (for OBJLoader to set material)
@@ -21,17 +29,20 @@ public:
     std::vector<GLuint> indices;
     glm::vec3 origin;
     glm::vec3 orientation;
-    GLuint texture_id{ 0 };
     GLenum primitive_type = GL_POINT;
     ShaderProgram shader;
 
-    // Material properties
-    glm::vec4 ambient_material{ 1.0f };
-    glm::vec4 diffuse_material{ 1.0f };
-    glm::vec4 specular_material{ 1.0f };
-    float reflectivity{ 1.0f };
+    // Shared surface parameters and texture (materials::get()), never null
+    std::shared_ptr<Material> material;
 
 private:
-    // OpenGL buffer IDs
-    unsigned int VAO{ 0 }, VBO{ 0 }, EBO{ 0 };
+    // OpenGL objects, the vertex and index data are suballocated from the shared buffers
+    unsigned int VAO{ 0 };
+    GpuAllocator::Allocation vertex_allocation;
+    GpuAllocator::Allocation index_allocation;
+    // Uniforms set on every draw, resolved once in the constructor
+    ShaderProgram::UniformHandle tex0_uniform;
+    ShaderProgram::UniformHandle material_uniform;
+
+    void applyMaterial() const;
 };
\ No newline at end of file
@@ -40,6 +40,7 @@ Model::Model(const std::filesystem::path& filename, ShaderProgram shader) {
 
     Mesh mesh(GL_TRIANGLES, shader, mesh_vertices, indices, glm::vec3(0.0f), glm::vec3(0.0f));
     meshes.push_back(mesh);
+    computeLocalBounds();
 }
 
 void Model::update(const float delta_t) {
@@ -79,6 +80,10 @@ void Model::draw(glm::vec3 const& offset, glm::vec3 const& rotation, glm::vec3 c
 
 void Model::draw(glm::mat4 const& model_matrix) {
     shader.activate();
+    drawMeshes();
+}
+
+void Model::drawMeshes() {
     for (auto& mesh : meshes) {
         mesh.draw();
     }
@@ -110,4 +115,32 @@ glm::vec3 Model::getMaxBounds() const {
         }
     }
     return maxBounds;
-}
\ No newline at end of file
+}
+
+void Model::computeLocalBounds() {
+    local_min = glm::vec3(FLT_MAX);
+    local_max = glm::vec3(-FLT_MAX);
+    for (const auto& mesh : meshes) {
+        for (const auto& v : mesh.vertices) {
+            local_min = glm::min(local_min, v.position);
+            local_max = glm::max(local_max, v.position);
+        }
+    }
+    if (local_min.x > local_max.x) {
+        local_min = local_max = glm::vec3(0.0f);
+    }
+}
+
+void Model::getWorldBounds(glm::vec3& min_out, glm::vec3& max_out) const {
+    glm::mat4 modelMatrix = getModelMatrix();
+    min_out = glm::vec3(FLT_MAX);
+    max_out = glm::vec3(-FLT_MAX);
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? local_max.x : local_min.x,
+            (i & 2) ? local_max.y : local_min.y,
+            (i & 4) ? local_max.z : local_min.z);
+        glm::vec3 transformed = glm::vec3(modelMatrix * glm::vec4(corner, 1.0f));
+        min_out = glm::min(min_out, transformed);
+        max_out = glm::max(max_out, transformed);
+    }
+}
@@ -23,6 +23,10 @@ public:
 
     // Transparency flag - ADDED FOR TASK 1
     bool transparent{ false };
+    // Rasterized into the software occlusion buffer (big closed shapes like walls)
+    bool occluder{ false };
+    // Tested with hardware occlusion queries in OcclusionMode::Queries (heavy meshes)
+    bool query_occlusion{ false };
     float currentTime{ 0.0f };
     ShaderProgram shader;
 
@@ -37,6 +41,15 @@ public:
         glm::vec3 const& rotation = glm::vec3(0.0f),
         glm::vec3 const& scale_change = glm::vec3(1.0f));
     void draw(glm::mat4 const& model_matrix);
+    // Draws the meshes with the program already active (RenderQueue switches programs itself)
+    void drawMeshes();
     glm::vec3 getMinBounds() const;
     glm::vec3 getMaxBounds() const;
+
+    // Cached object space bounds of all meshes, computed once after loading
+    glm::vec3 local_min{ 0.0f };
+    glm::vec3 local_max{ 0.0f };
+    void computeLocalBounds();
+    // Conservative world space AABB (transformed corners of the local box)
+    void getWorldBounds(glm::vec3& min_out, glm::vec3& max_out) const;
 };
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "OcclusionQueries.hpp"
+#include "GLState.hpp"
+#include <chrono>
+
+void OcclusionQueries::init() {
+    box_program = ShaderProgram("resources/shaders/bbox.vert", "resources/shaders/bbox.frag");
+    min_uniform = box_program.uniform("uMin");
+    max_uniform = box_program.uniform("uMax");
+
+    // Unit cube, scaled to the bounds in the vertex shader
+    const glm::vec3 corners[8] = {
+        {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}, {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}
+    };
+    const GLuint indices[36] = {
+        0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5
+    };
+    glCreateVertexArrays(1, &VAO);
+    glCreateBuffers(1, &VBO);
+    glNamedBufferData(VBO, sizeof(corners), corners, GL_STATIC_DRAW);
+    glCreateBuffers(1, &EBO);
+    glNamedBufferData(EBO, sizeof(indices), indices, GL_STATIC_DRAW);
+    glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(glm::vec3));
+    glVertexArrayElementBuffer(VAO, EBO);
+    glEnableVertexArrayAttrib(VAO, 0);
+    glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(VAO, 0, 0);
+}
+
+bool OcclusionQueries::needsQuery(const State& state) const {
+    if (state.in_flight) return false; // the previous result has not arrived yet
+    if (!state.visible || state.issued_frame < 0) return true;
+    return (frame + state.jitter) % visible_query_interval == 0;
+}
+
+void OcclusionQueries::beginFrame() {
+    frame++;
+    issued = 0;
+    pending = 0;
+    occluded = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    int latency_sum = 0;
+    int results = 0;
+    for (auto& [model, state] : states) {
+        if (state.in_flight) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint any_samples = 0;
+                glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &any_samples);
+                state.visible = any_samples != 0;
+                state.in_flight = false;
+                latency_sum += frame - state.issued_frame;
+                results++;
+            }
+            else {
+                pending++; // keeps the old visibility instead of stalling
+            }
+        }
+        if (!state.visible) occluded++;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    query_wait_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    if (results > 0) {
+        average_latency = static_cast<float>(latency_sum) / results;
+    }
+}
+
+bool OcclusionQueries::wasVisible(const Model* model) const {
+    auto it = states.find(model);
+    return it == states.end() || it->second.visible;
+}
+
+GLuint OcclusionQueries::getConditionQuery(const Model* model) const {
+    auto it = states.find(model);
+    if (it == states.end() || it->second.visible) {
+        return 0;
+    }
+    return it->second.query;
+}
+
+void OcclusionQueries::issueQueries(const std::vector<Model*>& objects, const glm::vec3& camera_position) {
+    if (box_program.getID() == 0) {
+        return;
+    }
+
+    bool cull_face = gl_state::isEnabled(GL_CULL_FACE);
+    gl_state::colorMask(false);
+    gl_state::depthMask(false);
+    gl_state::disable(GL_CULL_FACE); // the camera may look at the back faces of a box
+    box_program.activate();
+    gl_state::bindVertexArray(VAO);
+
+    for (Model* model : objects) {
+        State& state = states[model];
+        if (state.query == 0) {
+            glCreateQueries(GL_ANY_SAMPLES_PASSED, 1, &state.query);
+            state.jitter = static_cast<int>(states.size() % visible_query_interval);
+        }
+        if (!needsQuery(state)) continue;
+
+        glm::vec3 bmin, bmax;
+        model->getWorldBounds(bmin, bmax);
+        // Visible objects are queried after their own draw. Where the box lies on the surface (crates, walls)
+        // it would depth-fail against the object itself and flicker between visible and occluded, so the box
+        // is pushed outward by more than the depth precision at its distance.
+        float margin = 0.05f + 0.01f * glm::length(0.5f * (bmin + bmax) - camera_position);
+        bmin -= glm::vec3(margin);
+        bmax += glm::vec3(margin);
+        // a box around the camera would be clipped by the near plane, such objects are simply visible
+        if (glm::all(glm::greaterThanEqual(camera_position, bmin - 1.0f)) && glm::all(glm::lessThanEqual(camera_position, bmax + 1.0f))) {
+            state.visible = true;
+            continue;
+        }
+
+        box_program.setUniform(min_uniform, bmin);
+        box_program.setUniform(max_uniform, bmax);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, state.query);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        state.in_flight = true;
+        state.issued_frame = frame;
+        issued++;
+    }
+
+    gl_state::colorMask(true);
+    gl_state::depthMask(true);
+    if (cull_face) gl_state::enable(GL_CULL_FACE);
+}
+
+void OcclusionQueries::cleanup() {
+    for (auto& [model, state] : states) {
+        glDeleteQueries(1, &state.query);
+    }
+    states.clear();
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &VBO);
+    gl_state::deleteVertexArrays(1, &VAO);
+    VAO = VBO = EBO = 0;
+    box_program.clear();
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <GL/glew.h>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Model.hpp"
+#include "ShaderProgram.hpp"
+
+// Hardware occlusion queries with temporal coherence (simplified CHC++).
+// Every tracked object keeps the visibility from the last query result that arrived:
+//  - visible objects are drawn normally and re-queried only every visible_query_interval frames
+//    (interval jittered per object so the queries spread over frames),
+//  - invisible objects get a GL_ANY_SAMPLES_PASSED query on their bounding box (grown by a distance
+//    dependent margin, so it never depth-fails against the object's own surface) every frame
+//    and are drawn with conditional rendering, so the GPU decides without a CPU round trip.
+// Results are only read when GL_QUERY_RESULT_AVAILABLE says so, the CPU never waits for the GPU.
+class OcclusionQueries {
+public:
+    void init();
+    void cleanup();
+
+    // Collects the query results that are already available
+    void beginFrame();
+    // Visibility known from the last query result (true for objects that were never queried)
+    bool wasVisible(const Model* model) const;
+    // Issues bounding box queries for the objects that need one, must be called after the occluders are drawn.
+    // Changes the current program and restores color / depth writes and face culling afterwards.
+    // The boxes are projected with the Frame block (FrameUniforms).
+    void issueQueries(const std::vector<Model*>& objects, const glm::vec3& camera_position);
+    // Query to condition the draw of an invisible object on (glBeginConditionalRender), 0 = draw unconditionally
+    GLuint getConditionQuery(const Model* model) const;
+
+    int visible_query_interval = 8;
+
+    // Statistics of the last frame
+    size_t getIssued() const { return issued; }
+    size_t getPending() const { return pending; }
+    size_t getOccluded() const { return occluded; }
+    double getQueryWaitMs() const { return query_wait_ms; } // time spent in query result calls
+    float getAverageLatency() const { return average_latency; } // frames until results were available
+
+private:
+    struct State {
+        GLuint query = 0;
+        bool visible = true;
+        bool in_flight = false;
+        int issued_frame = -1; // never queried
+        int jitter = 0;
+    };
+
+    std::unordered_map<const Model*, State> states;
+    ShaderProgram box_program;
+    ShaderProgram::UniformHandle min_uniform;
+    ShaderProgram::UniformHandle max_uniform;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    int frame = 0;
+
+    size_t issued = 0;
+    size_t pending = 0;
+    size_t occluded = 0;
+    double query_wait_ms = 0.0;
+    float average_latency = 0.0f;
+
+    bool needsQuery(const State& state) const;
+};
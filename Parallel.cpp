@@ -0,0 +1,92 @@
+#include "Parallel.hpp"
+
+namespace {
+    // Set while the thread executes jobs of a run(), nested calls run serially instead of locking run_mutex again
+    thread_local bool inside_run = false;
+}
+
+ThreadPool& ThreadPool::get() {
+    static ThreadPool instance;
+    return instance;
+}
+
+ThreadPool::ThreadPool() {
+    int count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) - 1;
+    threads.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        threads.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) thread.join();
+}
+
+void ThreadPool::takeJobs(const std::function<void(int)>& fn, int count) {
+    for (int j = next_job.fetch_add(1); j < count; j = next_job.fetch_add(1)) {
+        fn(j);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) done.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&]() { return stopping || generation != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = generation;
+        const std::function<void(int)>* fn = job;
+        if (fn == nullptr) {
+            continue; // woke up after the run was already finished
+        }
+        int count = job_count;
+        active++;
+        lock.unlock();
+
+        inside_run = true;
+        takeJobs(*fn, count);
+        inside_run = false;
+
+        lock.lock();
+        // run() must not reset next_job while a worker can still increment it
+        if (--active == 0) done.notify_all();
+    }
+}
+
+void ThreadPool::run(int count, const std::function<void(int)>& fn) {
+    if (count <= 0) {
+        return;
+    }
+    // try_lock only after inside_run: the thread would already own run_mutex for a nested call
+    std::unique_lock<std::mutex> running(run_mutex, std::defer_lock);
+    if (count == 1 || threads.empty() || inside_run || !running.try_lock()) {
+        for (int j = 0; j < count; ++j) fn(j);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        job_count = count;
+        next_job = 0;
+        pending = count;
+        generation++;
+    }
+    wake.notify_all();
+    inside_run = true;
+    takeJobs(fn, count);
+    inside_run = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return pending == 0 && active == 0; });
+    job = nullptr;
+}
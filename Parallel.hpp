@@ -0,0 +1,96 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads created once (hardware_concurrency - 1 of them) and kept until exit.
+// run() hands out jobs through an atomic counter, the calling thread takes jobs as well and returns
+// when all of them are finished. One run() at a time: a call from inside a job (tracked per thread) or from
+// a second thread while the workers are busy runs its jobs serially on the calling thread instead of waiting.
+class ThreadPool {
+public:
+    static ThreadPool& get();
+
+    // Threads taking part in run(), the caller included
+    int getWorkerCount() const { return static_cast<int>(threads.size()) + 1; }
+    // Calls job(j) for every j in [0, job_count)
+    void run(int job_count, const std::function<void(int)>& job);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+    ThreadPool();
+    ~ThreadPool();
+    void workerLoop();
+    void takeJobs(const std::function<void(int)>& job, int job_count);
+
+    std::vector<std::thread> threads;
+    std::mutex run_mutex;                // held for the whole run()
+    std::mutex mutex;                    // guards the fields below
+    std::condition_variable wake, done;
+    const std::function<void(int)>* job = nullptr;
+    int job_count = 0;
+    std::atomic<int> next_job{ 0 };
+    int pending = 0;                     // jobs not finished yet
+    int active = 0;                      // workers still inside the current run
+    uint64_t generation = 0;             // bumped by every run(), wakes the workers
+    bool stopping = false;
+};
+
+// Splits the range [begin, end) into contiguous chunks, one per worker of the ThreadPool,
+// and runs fn(i) for every index. The calling thread processes chunks as well.
+template <typename Fn>
+void parallel_for(int begin, int end, Fn&& fn, int min_chunk = 16) {
+    int count = end - begin;
+    if (count <= 0) {
+        return;
+    }
+
+    ThreadPool& pool = ThreadPool::get();
+    int workers = std::min(pool.getWorkerCount(), std::max(1, count / std::max(1, min_chunk)));
+    if (workers == 1) {
+        for (int i = begin; i < end; ++i) fn(i);
+        return;
+    }
+
+    int chunk = (count + workers - 1) / workers;
+    pool.run(workers, [&](int w) {
+        int from = begin + w * chunk;
+        int to = std::min(end, from + chunk);
+        for (int i = from; i < to; ++i) fn(i);
+    });
+}
+
+// Same as parallel_for, but fn(worker, from, to) receives whole chunks so that
+// every worker can keep its own scratch memory.
+template <typename Fn>
+void parallel_chunks(int begin, int end, Fn&& fn, int min_chunk = 16) {
+    int count = end - begin;
+    if (count <= 0) {
+        return;
+    }
+
+    ThreadPool& pool = ThreadPool::get();
+    int workers = std::min(pool.getWorkerCount(), std::max(1, count / std::max(1, min_chunk)));
+    int chunk = (count + workers - 1) / workers;
+    if (workers == 1) {
+        fn(0, begin, end);
+        return;
+    }
+
+    pool.run(workers, [&](int w) {
+        int from = std::min(end, begin + w * chunk);
+        int to = std::min(end, from + chunk);
+        fn(w, from, to);
+    });
+}
+
+inline int parallel_worker_count() {
+    return ThreadPool::get().getWorkerCount();
+}
@@ -0,0 +1,76 @@
+#include "PerObjectLights.hpp"
+#include <algorithm>
+
+// Lights without falloff would give infinite bounds, which the BVH can not split
+static constexpr float MAX_LIGHT_RADIUS = 1.0e6f;
+
+void PerObjectLights::update(const Lights& lights) {
+    entries.clear();
+    for (size_t i = 0; i < lights.pointLights.size(); ++i) {
+        const PointLight& light = lights.pointLights[i];
+        float radius = std::min(light.influenceRadius(), MAX_LIGHT_RADIUS);
+        entries.push_back({ light.position, brightestChannel(light.ambient, light.diffuse, light.specular),
+            glm::vec4(light.position, radius), radius, light.constant, light.linear, light.quadratic,
+            static_cast<GLint>(i) });
+    }
+    for (size_t i = 0; i < lights.spotLights.size(); ++i) {
+        const SpotLight& light = lights.spotLights[i];
+        glm::vec4 sphere = light.boundingSphere();
+        sphere.w = std::min(sphere.w, MAX_LIGHT_RADIUS);
+        entries.push_back({ light.position, brightestChannel(light.ambient, light.diffuse, light.specular),
+            sphere, std::min(light.influenceRadius(), MAX_LIGHT_RADIUS), light.constant, light.linear, light.quadratic,
+            -static_cast<GLint>(i) - 1 });
+    }
+
+    if (entries.empty()) {
+        bvh = SceneBVH();
+        return;
+    }
+    std::vector<AABB> bounds;
+    bounds.reserve(entries.size());
+    for (const Entry& entry : entries) {
+        glm::vec3 center(entry.sphere);
+        bounds.emplace_back(center - entry.sphere.w, center + entry.sphere.w);
+    }
+    if (bvh.getItemCount() != entries.size()) {
+        bvh.build(bounds);
+    }
+    else {
+        for (size_t i = 0; i < bounds.size(); ++i) bvh.updateItem(static_cast<int>(i), bounds[i]);
+        bvh.refit();
+    }
+}
+
+int PerObjectLights::assign(const glm::vec3& box_min, const glm::vec3& box_max, GLint out[MAX_LIGHTS]) {
+    objects++;
+    if (bvh.empty()) {
+        return 0;
+    }
+
+    candidates.clear();
+    bvh.queryRadius((box_min + box_max) * 0.5f, glm::length(box_max - box_min) * 0.5f, candidates);
+
+    // relevance = light intensity at the closest point of the box, with the same falloff as tex.frag
+    scored.clear();
+    for (int id : candidates) {
+        const Entry& entry = entries[id];
+        glm::vec3 center(entry.sphere);
+        glm::vec3 to_box = glm::clamp(center, box_min, box_max) - center;
+        if (glm::dot(to_box, to_box) > entry.sphere.w * entry.sphere.w) continue;
+
+        float distance = glm::length(glm::clamp(entry.position, box_min, box_max) - entry.position);
+        if (distance >= entry.radius) continue;
+        float x = distance / entry.radius;
+        float window = 1.0f - x * x * x * x;
+        float attenuation = window * window / (entry.constant + entry.linear * distance + entry.quadratic * distance * distance);
+        scored.emplace_back(entry.brightness * attenuation, entry.shader_index);
+    }
+
+    int count = std::min(static_cast<int>(scored.size()), MAX_LIGHTS);
+    std::partial_sort(scored.begin(), scored.begin() + count, scored.end(),
+        [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (int i = 0; i < count; ++i) out[i] = scored[i].second;
+    assigned += count;
+    dropped += scored.size() - count;
+    return count;
+}
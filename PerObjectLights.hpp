@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Lights.hpp"
+#include "SceneBVH.hpp"
+
+// Light culling per draw for the forward path, the simpler alternative to ClusteredLighting.
+// Point and spot lights are kept in a BVH of their influence spheres (refit every frame), every drawn
+// object queries it with its bounds and keeps the MAX_LIGHTS lights that are brightest at its closest point.
+// The list goes to tex.frag as a uniform array: point light i as i, spot light i as -(i + 1).
+class PerObjectLights {
+public:
+    static constexpr int MAX_LIGHTS = 8; // must match MAX_OBJECT_LIGHTS in tex.frag
+
+    // Refits (or rebuilds, when the light count changed) the light BVH
+    void update(const Lights& lights);
+    // Most relevant lights for the box, returns their count
+    int assign(const glm::vec3& box_min, const glm::vec3& box_max, GLint out[MAX_LIGHTS]);
+
+    // Statistics since resetStats()
+    void resetStats() { objects = assigned = dropped = 0; }
+    size_t getObjects() const { return objects; }
+    size_t getAssigned() const { return assigned; }
+    size_t getDropped() const { return dropped; } // touching lights left out because of MAX_LIGHTS
+
+private:
+    struct Entry {
+        glm::vec3 position;
+        float brightness; // brightest channel of ambient, diffuse and specular
+        glm::vec4 sphere; // culling sphere, xyz center, w radius
+        float radius;     // influence radius from the attenuation
+        float constant, linear, quadratic;
+        GLint shader_index;
+    };
+
+    std::vector<Entry> entries;
+    SceneBVH bvh;
+    std::vector<int> candidates;
+    std::vector<std::pair<float, GLint>> scored;
+
+    size_t objects = 0;
+    size_t assigned = 0;
+    size_t dropped = 0;
+};
@@ -0,0 +1,273 @@
+#include "PotentiallyVisibleSet.hpp"
+#include "Maze.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    constexpr char PVS_MAGIC[4] = { 'P', 'V', 'S', '2' }; // 2: visible sets dilated by one ring
+    // Free tiles per PVS cell used as ray end points; part of the cache hash
+    constexpr int PVS_SAMPLES_PER_CELL = 9;
+}
+
+uint64_t PotentiallyVisibleSet::hashMap(const cv::Mat& maze_map, int cell_size) {
+    // FNV-1a over the parameters and the map contents
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
+    mix(static_cast<uint64_t>(maze_map.cols));
+    mix(static_cast<uint64_t>(maze_map.rows));
+    mix(static_cast<uint64_t>(cell_size));
+    mix(static_cast<uint64_t>(PVS_SAMPLES_PER_CELL));
+    for (int y = 0; y < maze_map.rows; ++y) {
+        for (int x = 0; x < maze_map.cols; ++x) {
+            hash ^= maze_map.at<uchar>(y, x);
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+void PotentiallyVisibleSet::loadOrBuild(const cv::Mat& maze_map, const std::filesystem::path& cache_file, int cell_size) {
+    uint64_t hash = hashMap(maze_map, cell_size);
+    if (load(cache_file, hash)) {
+        std::cout << "PVS loaded from cache " << cache_file << " (" << getCellCount() << " cells)" << std::endl;
+        return;
+    }
+
+    build(maze_map, cell_size);
+    std::cout << "PVS built for " << getCellCount() << " cells in " << build_time_ms << " ms" << std::endl;
+    if (!save(cache_file)) {
+        std::cerr << "Failed to write PVS cache: " << cache_file << std::endl;
+    }
+}
+
+void PotentiallyVisibleSet::build(const cv::Mat& maze_map, int cell_size) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    this->cell_size = std::max(1, cell_size);
+    map_width = maze_map.cols;
+    map_height = maze_map.rows;
+    map_hash = hashMap(maze_map, this->cell_size);
+    cells_x = (map_width + this->cell_size - 1) / this->cell_size;
+    cells_y = (map_height + this->cell_size - 1) / this->cell_size;
+    int cell_count = cells_x * cells_y;
+    words_per_row = (cell_count + 63) / 64;
+    visibility.assign(static_cast<size_t>(cell_count) * words_per_row, 0);
+
+    // Ray end points: evenly spread free tile centers of every cell
+    std::vector<std::vector<glm::vec2>> samples(cell_count);
+    parallel_for(0, cell_count, [&](int c) {
+        int x0 = (c % cells_x) * this->cell_size;
+        int y0 = (c / cells_x) * this->cell_size;
+        std::vector<glm::vec2> free_tiles;
+        for (int y = y0; y < std::min(y0 + this->cell_size, map_height); ++y) {
+            for (int x = x0; x < std::min(x0 + this->cell_size, map_width); ++x) {
+                if (!maze::isWall(maze_map, x, y)) {
+                    free_tiles.emplace_back(x + 0.5f, y + 0.5f);
+                }
+            }
+        }
+        if (free_tiles.size() <= PVS_SAMPLES_PER_CELL) {
+            samples[c] = free_tiles;
+        }
+        else {
+            for (int i = 0; i < PVS_SAMPLES_PER_CELL; ++i) {
+                samples[c].push_back(free_tiles[i * free_tiles.size() / PVS_SAMPLES_PER_CELL]);
+            }
+        }
+    });
+
+    // Upper triangle only: every source cell writes just its own bitset row.
+    // Rows are interleaved (0, n-1, 1, n-2, ...) so that every thread gets a similar amount of pairs.
+    parallel_for(0, cell_count, [&](int i) {
+        int from = (i % 2 == 0) ? i / 2 : cell_count - 1 - i / 2;
+        int fx = from % cells_x;
+        int fy = from / cells_x;
+        setVisible(from, from);
+        for (int to = from + 1; to < cell_count; ++to) {
+            int tx = to % cells_x;
+            int ty = to / cells_x;
+            // Neighbouring cells are always visible, the camera can step over the border any time
+            if (std::abs(tx - fx) <= 1 && std::abs(ty - fy) <= 1) {
+                setVisible(from, to);
+                continue;
+            }
+            bool visible = false;
+            for (const auto& a : samples[from]) {
+                for (const auto& b : samples[to]) {
+                    if (rayClear(maze_map, a, b)) {
+                        visible = true;
+                        break;
+                    }
+                }
+                if (visible) break;
+            }
+            if (visible) {
+                setVisible(from, to);
+            }
+        }
+    }, 1);
+
+    // Mirror into the lower triangle
+    for (int from = 0; from < cell_count; ++from) {
+        for (int to = from + 1; to < cell_count; ++to) {
+            if (isVisible(from, to)) {
+                setVisible(to, from);
+            }
+        }
+    }
+
+    // The rays only start at a few points of the source cell, spots in between can see past corners the
+    // samples cannot. Every visible cell brings its neighbours along, so such walls are drawn a cell early
+    // instead of popping in while the camera crosses the cell.
+    std::vector<uint64_t> sampled = visibility;
+    parallel_for(0, cell_count, [&](int from) {
+        const uint64_t* row = sampled.data() + static_cast<size_t>(from) * words_per_row;
+        for (int to = 0; to < cell_count; ++to) {
+            if (!((row[to >> 6] >> (to & 63)) & 1ull)) continue;
+            int tx = to % cells_x;
+            int ty = to / cells_x;
+            for (int ny = std::max(ty - 1, 0); ny <= std::min(ty + 1, cells_y - 1); ++ny) {
+                for (int nx = std::max(tx - 1, 0); nx <= std::min(tx + 1, cells_x - 1); ++nx) {
+                    setVisible(from, ny * cells_x + nx);
+                }
+            }
+        }
+    }, 1);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    build_time_ms = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// 2D DDA through maze tiles, false when a wall tile lies between a and b
+bool PotentiallyVisibleSet::rayClear(const cv::Mat& maze_map, glm::vec2 a, glm::vec2 b) {
+    int x = static_cast<int>(std::floor(a.x));
+    int y = static_cast<int>(std::floor(a.y));
+    int end_x = static_cast<int>(std::floor(b.x));
+    int end_y = static_cast<int>(std::floor(b.y));
+    glm::vec2 dir = b - a;
+
+    int step_x = dir.x > 0.0f ? 1 : -1;
+    int step_y = dir.y > 0.0f ? 1 : -1;
+    float t_max_x = dir.x != 0.0f ? ((x + (step_x > 0 ? 1 : 0)) - a.x) / dir.x : FLT_MAX;
+    float t_max_y = dir.y != 0.0f ? ((y + (step_y > 0 ? 1 : 0)) - a.y) / dir.y : FLT_MAX;
+    float t_delta_x = dir.x != 0.0f ? std::abs(1.0f / dir.x) : FLT_MAX;
+    float t_delta_y = dir.y != 0.0f ? std::abs(1.0f / dir.y) : FLT_MAX;
+
+    int steps = std::abs(end_x - x) + std::abs(end_y - y);
+    for (int i = 0; i < steps; ++i) {
+        if (t_max_x < t_max_y) {
+            x += step_x;
+            t_max_x += t_delta_x;
+        }
+        else {
+            y += step_y;
+            t_max_y += t_delta_y;
+        }
+        if (maze::isWall(maze_map, x, y)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PotentiallyVisibleSet::setVisible(int from_cell, int to_cell) {
+    visibility[static_cast<size_t>(from_cell) * words_per_row + (to_cell >> 6)] |= 1ull << (to_cell & 63);
+}
+
+bool PotentiallyVisibleSet::isVisible(int from_cell, int to_cell) const {
+    return (visibility[static_cast<size_t>(from_cell) * words_per_row + (to_cell >> 6)] >> (to_cell & 63)) & 1ull;
+}
+
+int PotentiallyVisibleSet::cellAt(const glm::vec3& world_pos) const {
+    glm::ivec2 tile = maze::worldToCell(world_pos);
+    if (tile.x < 0 || tile.y < 0 || tile.x >= map_width || tile.y >= map_height) {
+        return -1;
+    }
+    return (tile.y / cell_size) * cells_x + tile.x / cell_size;
+}
+
+bool PotentiallyVisibleSet::isBoxVisible(int from_cell, const glm::vec3& box_min, const glm::vec3& box_max) const {
+    if (visibility.empty() || from_cell < 0 || box_max.y > maze::WALL_HEIGHT) {
+        return true;
+    }
+
+    glm::ivec2 tile_min = maze::worldToCell(box_min);
+    glm::ivec2 tile_max = maze::worldToCell(box_max);
+    if (tile_min.x < 0 || tile_min.y < 0 || tile_max.x >= map_width || tile_max.y >= map_height) {
+        return true; // not fully covered by the maze
+    }
+
+    for (int cy = tile_min.y / cell_size; cy <= tile_max.y / cell_size; ++cy) {
+        for (int cx = tile_min.x / cell_size; cx <= tile_max.x / cell_size; ++cx) {
+            if (isVisible(from_cell, cy * cells_x + cx)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool PotentiallyVisibleSet::save(const std::filesystem::path& cache_file) const {
+    std::error_code ec;
+    if (cache_file.has_parent_path()) {
+        std::filesystem::create_directories(cache_file.parent_path(), ec);
+    }
+    std::ofstream file(cache_file, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    int32_t header[5] = { map_width, map_height, cell_size, cells_x, cells_y };
+    file.write(PVS_MAGIC, sizeof(PVS_MAGIC));
+    file.write(reinterpret_cast<const char*>(&map_hash), sizeof(map_hash));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(visibility.data()), visibility.size() * sizeof(uint64_t));
+    return file.good();
+}
+
+bool PotentiallyVisibleSet::load(const std::filesystem::path& cache_file, uint64_t expected_hash) {
+    std::ifstream file(cache_file, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    char magic[4];
+    uint64_t hash = 0;
+    int32_t header[5];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || std::memcmp(magic, PVS_MAGIC, sizeof(magic)) != 0 || hash != expected_hash) {
+        std::cout << "PVS cache " << cache_file << " is stale, rebuilding" << std::endl;
+        return false;
+    }
+
+    int cell_count = header[3] * header[4];
+    std::vector<uint64_t> bits(static_cast<size_t>(cell_count) * ((cell_count + 63) / 64));
+    file.read(reinterpret_cast<char*>(bits.data()), bits.size() * sizeof(uint64_t));
+    if (!file) {
+        return false;
+    }
+
+    map_width = header[0];
+    map_height = header[1];
+    cell_size = header[2];
+    cells_x = header[3];
+    cells_y = header[4];
+    words_per_row = (cell_count + 63) / 64;
+    map_hash = hash;
+    visibility = std::move(bits);
+    build_time_ms = 0.0;
+    return true;
+}
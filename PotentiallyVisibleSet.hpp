@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <glm/glm.hpp>
+
+// Cell-to-cell potentially visible set for the grid maze.
+// maze_map is split into square PVS cells of cell_size x cell_size tiles. Visibility between two
+// cells is found by casting 2D rays between free tiles of both cells (in parallel over source cells),
+// the sets are then dilated by one ring of neighbour cells to cover views from between the ray samples.
+// At runtime the set of cells visible from the camera is a single bitset row.
+class PotentiallyVisibleSet {
+public:
+    PotentiallyVisibleSet() = default;
+
+    // Loads the PVS from cache_file when it matches the map, otherwise builds it and writes the cache
+    void loadOrBuild(const cv::Mat& maze_map, const std::filesystem::path& cache_file, int cell_size = 16);
+    void build(const cv::Mat& maze_map, int cell_size = 16);
+    bool load(const std::filesystem::path& cache_file, uint64_t expected_hash);
+    bool save(const std::filesystem::path& cache_file) const;
+
+    bool empty() const { return visibility.empty(); }
+    int getCellCount() const { return cells_x * cells_y; }
+    double getBuildTimeMs() const { return build_time_ms; }
+
+    // Index of the PVS cell containing the world position, -1 outside of the map
+    int cellAt(const glm::vec3& world_pos) const;
+    bool isVisible(int from_cell, int to_cell) const;
+    // True if any PVS cell overlapped by the world AABB is visible from from_cell.
+    // Conservative: everything is visible from outside the map and boxes taller than the walls always pass.
+    bool isBoxVisible(int from_cell, const glm::vec3& box_min, const glm::vec3& box_max) const;
+
+    static uint64_t hashMap(const cv::Mat& maze_map, int cell_size);
+
+private:
+    int map_width = 0;
+    int map_height = 0;
+    int cell_size = 16;
+    int cells_x = 0;
+    int cells_y = 0;
+    int words_per_row = 0;
+    uint64_t map_hash = 0;
+    double build_time_ms = 0.0;
+    std::vector<uint64_t> visibility; // cells_x * cells_y rows of words_per_row words
+
+    void setVisible(int from_cell, int to_cell);
+    static bool rayClear(const cv::Mat& maze_map, glm::vec2 a, glm::vec2 b);
+};
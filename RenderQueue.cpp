@@ -0,0 +1,106 @@
+#include "RenderQueue.hpp"
+#include <algorithm>
+#include <cstring>
+
+uint32_t RenderQueue::internId(std::unordered_map<GLuint, uint32_t>& ids, GLuint name, int bits) {
+    auto found = ids.find(name);
+    if (found != ids.end()) {
+        return found->second;
+    }
+    // past the field width ids are shared, the order stays correct, only the grouping gets coarser
+    uint32_t id = static_cast<uint32_t>(ids.size()) & ((1u << bits) - 1);
+    ids.emplace(name, id);
+    return id;
+}
+
+// The bits of a non-negative float increase with its value: the top 24 of them (after the sign bit)
+// keep the whole range with about 16 bits of relative precision
+uint32_t RenderQueue::quantizeDepth(float depth) {
+    depth = std::max(depth, 0.0f);
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (31 - DEPTH_BITS);
+}
+
+void RenderQueue::begin(const glm::vec3& view_position, const glm::vec3& view_direction) {
+    this->view_position = view_position;
+    this->view_direction = view_direction;
+    items.clear();
+    entries.clear();
+    draw_count = program_changes = material_changes = 0;
+}
+
+void RenderQueue::add(Pass pass, Model* model) {
+    GLuint program = model->shader.getID();
+    GLuint material = model->meshes.empty() ? 0 : model->meshes[0].material->getIndex();
+    glm::vec3 bmin, bmax;
+    model->getWorldBounds(bmin, bmax);
+    uint64_t depth = quantizeDepth(glm::dot(0.5f * (bmin + bmax) - view_position, view_direction));
+    uint64_t program_id = internId(program_ids, program, PROGRAM_BITS);
+    uint64_t material_id = internId(material_ids, material, MATERIAL_BITS);
+
+    uint64_t key = static_cast<uint64_t>(pass) << PASS_SHIFT;
+    if (pass == Pass::Opaque) {
+        int program_shift = PASS_SHIFT - PROGRAM_BITS;
+        int material_shift = program_shift - MATERIAL_BITS;
+        key |= program_id << program_shift | material_id << material_shift | depth << (material_shift - DEPTH_BITS);
+    }
+    else {
+        int depth_shift = PASS_SHIFT - DEPTH_BITS;
+        int program_shift = depth_shift - PROGRAM_BITS;
+        uint64_t far_first = ((1ull << DEPTH_BITS) - 1) - depth;
+        key |= far_first << depth_shift | program_id << program_shift | material_id << (program_shift - MATERIAL_BITS);
+    }
+    entries.push_back({ key, static_cast<uint32_t>(items.size()) });
+    items.push_back({ model, program, material });
+}
+
+// LSD radix sort, stable, so equal keys keep the order they were added in
+void RenderQueue::sort() {
+    constexpr int DIGITS = 8;
+    size_t counts[DIGITS][256] = {};
+    for (const Entry& entry : entries) {
+        for (int d = 0; d < DIGITS; ++d) counts[d][(entry.key >> (d * 8)) & 0xff]++;
+    }
+    scratch.resize(entries.size());
+    for (int d = 0; d < DIGITS; ++d) {
+        size_t* count = counts[d];
+        if (count[(entries.empty() ? 0 : entries[0].key >> (d * 8)) & 0xff] == entries.size()) {
+            continue; // the same digit in every key
+        }
+        size_t offset = 0;
+        for (int b = 0; b < 256; ++b) {
+            size_t n = count[b];
+            count[b] = offset;
+            offset += n;
+        }
+        for (const Entry& entry : entries) {
+            scratch[count[(entry.key >> (d * 8)) & 0xff]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+void RenderQueue::submit(Pass pass, const std::function<void(Model*)>& draw) {
+    uint64_t pass_bits = static_cast<uint64_t>(pass);
+    auto first = std::partition_point(entries.begin(), entries.end(),
+        [&](const Entry& entry) { return (entry.key >> PASS_SHIFT) < pass_bits; });
+    GLuint current_program = 0;
+    GLuint current_material = 0;
+    bool first_draw = true;
+    for (auto it = first; it != entries.end() && (it->key >> PASS_SHIFT) == pass_bits; ++it) {
+        const Item& item = items[it->item];
+        if (first_draw || item.program != current_program) {
+            item.model->shader.activate();
+            current_program = item.program;
+            program_changes++;
+        }
+        if (first_draw || item.material != current_material) {
+            current_material = item.material;
+            material_changes++;
+        }
+        first_draw = false;
+        draw(item.model);
+        draw_count++;
+    }
+}
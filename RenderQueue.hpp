@@ -0,0 +1,60 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Model.hpp"
+
+// Per frame list of model draws ordered by packed 64-bit sort keys.
+// Opaque:      pass | program | material | depth (front to back)  - state changes first, then overdraw
+// Transparent: pass | depth (back to front) | program | material  - blending order first
+// The keys are radix sorted (8-bit digits, digits equal in all keys are skipped), submit() walks one pass
+// in key order and switches the program only when it differs from the previous draw.
+class RenderQueue {
+public:
+    enum class Pass { Opaque = 0, Transparent = 1 };
+
+    // Clears the queue, depth is measured along view_direction from view_position
+    void begin(const glm::vec3& view_position, const glm::vec3& view_direction);
+    void add(Pass pass, Model* model);
+    void sort();
+    // draw(model) sets the per draw uniforms and calls Model::drawMeshes(), the program is already active
+    void submit(Pass pass, const std::function<void(Model*)>& draw);
+
+    // Statistics of the submits since begin()
+    size_t getDrawCount() const { return draw_count; }
+    size_t getProgramChanges() const { return program_changes; }
+    size_t getMaterialChanges() const { return material_changes; }
+
+private:
+    static constexpr int PASS_SHIFT = 62;
+    static constexpr int DEPTH_BITS = 24;
+    static constexpr int PROGRAM_BITS = 8;
+    static constexpr int MATERIAL_BITS = 16;
+
+    struct Entry {
+        uint64_t key;
+        uint32_t item;
+    };
+    struct Item {
+        Model* model;
+        GLuint program;
+        GLuint material; // Material::getIndex() of the first mesh
+    };
+
+    glm::vec3 view_position{ 0.0f };
+    glm::vec3 view_direction{ 0.0f, 0.0f, -1.0f };
+    std::vector<Item> items;
+    std::vector<Entry> entries, scratch;
+    // small ids of programs and materials for the key fields, kept over frames
+    std::unordered_map<GLuint, uint32_t> program_ids, material_ids;
+
+    size_t draw_count = 0;
+    size_t program_changes = 0;
+    size_t material_changes = 0;
+
+    static uint32_t internId(std::unordered_map<GLuint, uint32_t>& ids, GLuint name, int bits);
+    static uint32_t quantizeDepth(float depth);
+};
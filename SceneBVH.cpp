@@ -0,0 +1,326 @@
+#include "SceneBVH.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+    // Traversal stack: the inline entries cover any reasonably balanced tree, a deeper one
+    // (degenerate input, long refit chains) spills to the heap instead of losing subtrees
+    template <typename T>
+    class TraversalStack {
+    public:
+        void push(const T& value) {
+            if (count < INLINE) local[count] = value;
+            else heap.push_back(value);
+            count++;
+        }
+        T pop() {
+            count--;
+            if (count < INLINE) return local[count];
+            T value = heap.back();
+            heap.pop_back();
+            return value;
+        }
+        bool empty() const { return count == 0; }
+
+    private:
+        static constexpr int INLINE = 64;
+        T local[INLINE];
+        std::vector<T> heap;
+        int count = 0;
+    };
+}
+
+namespace {
+    constexpr int BVH_MAX_LEAF_ITEMS = 2;
+    constexpr int BVH_BINS = 12;
+}
+
+AABB AABB::empty() {
+    return AABB(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+}
+
+void AABB::expand(const AABB& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+float AABB::surfaceArea() const {
+    glm::vec3 d = max - min;
+    if (d.x < 0.0f || d.y < 0.0f || d.z < 0.0f) return 0.0f;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool AABB::intersects(const AABB& other) const {
+    return (min.x <= other.max.x && max.x >= other.min.x) &&
+        (min.y <= other.max.y && max.y >= other.min.y) &&
+        (min.z <= other.max.z && max.z >= other.min.z);
+}
+
+void SceneBVH::build(const std::vector<AABB>& item_bounds) {
+    items = item_bounds;
+    rebuild();
+}
+
+void SceneBVH::rebuild() {
+    nodes.clear();
+    item_order.resize(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        item_order[i] = static_cast<int>(i);
+    }
+    dirty = false;
+    refits_since_build = 0;
+    if (items.empty()) {
+        built_cost = 0.0f;
+        return;
+    }
+
+    nodes.reserve(items.size() * 2);
+    nodes.emplace_back();
+    buildNode(0, 0, static_cast<int>(items.size()));
+    built_cost = sahCost();
+}
+
+void SceneBVH::buildNode(int node_index, int first, int count) {
+    AABB bounds = AABB::empty();
+    AABB centroids = AABB::empty();
+    for (int i = first; i < first + count; ++i) {
+        const AABB& b = items[item_order[i]];
+        bounds.expand(b);
+        centroids.expand(AABB(b.center(), b.center()));
+    }
+    nodes[node_index].bounds = bounds;
+
+    if (count <= BVH_MAX_LEAF_ITEMS) {
+        nodes[node_index].first = first;
+        nodes[node_index].count = count;
+        return;
+    }
+
+    // Split along the longest centroid axis, position chosen by binned SAH
+    glm::vec3 size = centroids.max - centroids.min;
+    int axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+    int mid = first + count / 2;
+
+    if (size[axis] > 0.0f) {
+        struct Bin { AABB bounds = AABB::empty(); int count = 0; } bins[BVH_BINS];
+        float scale = BVH_BINS / size[axis];
+        auto binOf = [&](int item) {
+            int b = static_cast<int>((items[item].center()[axis] - centroids.min[axis]) * scale);
+            return std::min(b, BVH_BINS - 1);
+        };
+        for (int i = first; i < first + count; ++i) {
+            Bin& bin = bins[binOf(item_order[i])];
+            bin.bounds.expand(items[item_order[i]]);
+            bin.count++;
+        }
+
+        float best_cost = FLT_MAX;
+        int best_split = -1;
+        for (int split = 1; split < BVH_BINS; ++split) {
+            AABB left = AABB::empty(), right = AABB::empty();
+            int left_count = 0, right_count = 0;
+            for (int b = 0; b < split; ++b) { left.expand(bins[b].bounds); left_count += bins[b].count; }
+            for (int b = split; b < BVH_BINS; ++b) { right.expand(bins[b].bounds); right_count += bins[b].count; }
+            if (left_count == 0 || right_count == 0) continue;
+            float cost = left.surfaceArea() * left_count + right.surfaceArea() * right_count;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_split = split;
+            }
+        }
+
+        if (best_split > 0) {
+            int* split_point = std::partition(item_order.data() + first, item_order.data() + first + count,
+                [&](int item) { return binOf(item) < best_split; });
+            mid = static_cast<int>(split_point - item_order.data());
+        }
+    }
+
+    // Degenerate split (all centroids in one spot): halve by count
+    if (mid == first || mid == first + count) {
+        mid = first + count / 2;
+        std::nth_element(item_order.begin() + first, item_order.begin() + mid, item_order.begin() + first + count,
+            [&](int a, int b) { return items[a].center()[axis] < items[b].center()[axis]; });
+    }
+
+    int left = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    nodes.emplace_back();
+    nodes[node_index].first = left;
+    nodes[node_index].count = 0;
+    buildNode(left, first, mid - first);
+    buildNode(left + 1, mid, first + count - mid);
+}
+
+float SceneBVH::sahCost() const {
+    if (nodes.empty()) return 0.0f;
+    float root_area = std::max(nodes[0].bounds.surfaceArea(), 1e-6f);
+    float cost = 0.0f;
+    for (const auto& node : nodes) {
+        float area = node.bounds.surfaceArea() / root_area;
+        cost += node.count > 0 ? area * node.count : area;
+    }
+    return cost;
+}
+
+void SceneBVH::updateItem(int item, const AABB& bounds) {
+    items[item] = bounds;
+    dirty = true;
+}
+
+void SceneBVH::refit() {
+    if (!dirty || nodes.empty()) {
+        return;
+    }
+    dirty = false;
+
+    if (++refits_since_build >= rebuild_interval) {
+        rebuild();
+        return;
+    }
+
+    // Children are always stored after their parent, so a reverse sweep is bottom-up
+    for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; --i) {
+        Node& node = nodes[i];
+        if (node.count > 0) {
+            node.bounds = AABB::empty();
+            for (int k = node.first; k < node.first + node.count; ++k) {
+                node.bounds.expand(items[item_order[k]]);
+            }
+        }
+        else {
+            node.bounds = nodes[node.first].bounds;
+            node.bounds.expand(nodes[node.first + 1].bounds);
+        }
+    }
+
+    if (sahCost() > built_cost * rebuild_ratio) {
+        rebuild();
+    }
+}
+
+void SceneBVH::queryFrustum(const glm::vec4 planes[6], std::vector<int>& out) const {
+    nodes_visited = 0;
+    if (nodes.empty()) return;
+
+    // Stack entries carry a flag telling that the parent was already fully inside
+    struct Entry {
+        int node;
+        bool inside;
+    };
+    TraversalStack<Entry> stack;
+    stack.push({ 0, false });
+    while (!stack.empty()) {
+        Entry entry = stack.pop();
+        const Node& node = nodes[entry.node];
+        bool fully_inside = entry.inside;
+        nodes_visited++;
+
+        if (!fully_inside) {
+            glm::vec3 c = node.bounds.center();
+            glm::vec3 e = node.bounds.extent();
+            bool outside = false;
+            fully_inside = true;
+            for (int p = 0; p < 6; ++p) {
+                glm::vec3 n(planes[p]);
+                float d = glm::dot(n, c) + planes[p].w;
+                float r = glm::dot(glm::abs(n), e);
+                if (d + r < 0.0f) { outside = true; break; }
+                if (d - r < 0.0f) fully_inside = false;
+            }
+            if (outside) continue;
+        }
+
+        if (node.count > 0) {
+            for (int k = node.first; k < node.first + node.count; ++k) {
+                out.push_back(item_order[k]);
+            }
+        }
+        else {
+            stack.push({ node.first, fully_inside });
+            stack.push({ node.first + 1, fully_inside });
+        }
+    }
+}
+
+void SceneBVH::queryRadius(const glm::vec3& center, float radius, std::vector<int>& out) const {
+    nodes_visited = 0;
+    if (nodes.empty()) return;
+
+    float radius2 = radius * radius;
+    auto overlaps = [&](const AABB& b) {
+        glm::vec3 closest = glm::clamp(center, b.min, b.max);
+        glm::vec3 d = closest - center;
+        return glm::dot(d, d) <= radius2;
+    };
+
+    TraversalStack<int> stack;
+    stack.push(0);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.pop()];
+        nodes_visited++;
+        if (!overlaps(node.bounds)) continue;
+        if (node.count > 0) {
+            for (int k = node.first; k < node.first + node.count; ++k) {
+                if (overlaps(items[item_order[k]])) out.push_back(item_order[k]);
+            }
+        }
+        else {
+            stack.push(node.first);
+            stack.push(node.first + 1);
+        }
+    }
+}
+
+int SceneBVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance, float* hit_distance) const {
+    nodes_visited = 0;
+    if (nodes.empty()) return -1;
+
+    glm::vec3 inv_dir(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    // Slab test, returns the entry distance or FLT_MAX on a miss
+    auto slab = [&](const AABB& b, float limit) {
+        glm::vec3 t0 = (b.min - origin) * inv_dir;
+        glm::vec3 t1 = (b.max - origin) * inv_dir;
+        glm::vec3 tmin = glm::min(t0, t1);
+        glm::vec3 tmax = glm::max(t0, t1);
+        float enter = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+        float exit = std::min(std::min(tmax.x, tmax.y), std::min(tmax.z, limit));
+        return enter <= exit ? enter : FLT_MAX;
+    };
+
+    int best_item = -1;
+    float best_t = max_distance;
+    TraversalStack<int> stack;
+    stack.push(0);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.pop()];
+        nodes_visited++;
+        if (slab(node.bounds, best_t) == FLT_MAX) continue;
+        if (node.count > 0) {
+            for (int k = node.first; k < node.first + node.count; ++k) {
+                float t = slab(items[item_order[k]], best_t);
+                if (t < best_t) {
+                    best_t = t;
+                    best_item = item_order[k];
+                }
+            }
+        }
+        else {
+            // visit the nearer child first so that best_t shrinks early
+            float tl = slab(nodes[node.first].bounds, best_t);
+            float tr = slab(nodes[node.first + 1].bounds, best_t);
+            if (tl < tr) {
+                if (tr != FLT_MAX) stack.push(node.first + 1);
+                if (tl != FLT_MAX) stack.push(node.first);
+            }
+            else {
+                if (tl != FLT_MAX) stack.push(node.first);
+                if (tr != FLT_MAX) stack.push(node.first + 1);
+            }
+        }
+    }
+
+    if (hit_distance && best_item >= 0) *hit_distance = best_t;
+    return best_item;
+}
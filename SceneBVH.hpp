@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+struct AABB {
+    glm::vec3 min{ 0.0f };
+    glm::vec3 max{ 0.0f };
+
+    AABB() = default;
+    AABB(const glm::vec3& mn, const glm::vec3& mx) : min(mn), max(mx) {}
+    static AABB empty();
+
+    void expand(const AABB& other);
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+    float surfaceArea() const;
+    bool intersects(const AABB& other) const;
+};
+
+// Bounding volume hierarchy over generic items (objects, lights, particle emitters...) identified by index.
+// Built top-down with binned SAH. Moving items are updated with refit(), and the tree is rebuilt
+// periodically or once refitting has degraded its SAH cost too much.
+class SceneBVH {
+public:
+    void build(const std::vector<AABB>& item_bounds);
+    void rebuild();
+
+    // Changes the bounds of one item, applied to the tree by the next refit()
+    void updateItem(int item, const AABB& bounds);
+    // Refits dirty bounds bottom-up; rebuilds when rebuild_interval refits passed or the tree quality dropped
+    void refit();
+
+    // Items whose bounds intersect the frustum (planes as xyz = normal, w = distance, inside is positive)
+    void queryFrustum(const glm::vec4 planes[6], std::vector<int>& out) const;
+    // Items whose bounds intersect the sphere
+    void queryRadius(const glm::vec3& center, float radius, std::vector<int>& out) const;
+    // Closest item whose bounds are hit by the ray, -1 when nothing is hit
+    int raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance, float* hit_distance = nullptr) const;
+
+    bool empty() const { return nodes.empty(); }
+    size_t getItemCount() const { return items.size(); }
+    size_t getNodeCount() const { return nodes.size(); }
+    size_t getNodesVisited() const { return nodes_visited; }
+    const AABB& getItemBounds(int item) const { return items[item]; }
+
+    int rebuild_interval = 600;  // refits between forced rebuilds
+    float rebuild_ratio = 1.5f;  // rebuild once the SAH cost grows by this factor
+
+private:
+    struct Node {
+        AABB bounds;
+        int first = 0;  // leaf: first entry in item_order, inner: index of the left child (right = left + 1)
+        int count = 0;  // items in a leaf, 0 for inner nodes
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> item_order;
+    std::vector<AABB> items;
+    bool dirty = false;
+    int refits_since_build = 0;
+    float built_cost = 0.0f;
+    mutable size_t nodes_visited = 0;
+
+    void buildNode(int node_index, int first, int count);
+    float sahCost() const;
+};
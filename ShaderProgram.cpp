@@ -1,4 +1,5 @@
 ﻿#include "ShaderProgram.hpp"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
@@ -47,7 +48,7 @@ GLuint ShaderProgram::link_shader(const std::vector<GLuint> shader_ids) {
     glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success) {
         std::string log = getProgramInfoLog(program);
-        glDeleteProgram(program);
+        gl_state::deleteProgram(program);
         throw std::runtime_error("Shader linking failed: " + log);
     }
 
@@ -64,6 +65,13 @@ ShaderProgram::ShaderProgram(const std::filesystem::path& VS_file, const std::fi
     GLuint vertexShader = compile_shader(VS_file, GL_VERTEX_SHADER);
     GLuint fragmentShader = compile_shader(FS_file, GL_FRAGMENT_SHADER);
     ID = link_shader({ vertexShader, fragmentShader });
+    reflect();
+}
+
+ShaderProgram::ShaderProgram(const std::filesystem::path& CS_file) {
+    GLuint computeShader = compile_shader(CS_file, GL_COMPUTE_SHADER);
+    ID = link_shader({ computeShader });
+    reflect();
 }
 
 // Error log helpers
@@ -83,38 +91,140 @@ std::string ShaderProgram::getProgramInfoLog(const GLuint obj) {
     return log;
 }
 
-// Uniform setters (example for float, others follow similarly)
+// Enumerates active uniforms, attributes and blocks once, lookups afterwards are plain hash lookups
+void ShaderProgram::reflect() {
+    auto result = std::make_shared<Reflection>();
+
+    auto resourceName = [this](GLenum interface_type, GLint index) {
+        GLint length = 0;
+        const GLenum name_length = GL_NAME_LENGTH;
+        glGetProgramResourceiv(ID, interface_type, index, 1, &name_length, 1, nullptr, &length);
+        std::string name(std::max(length, 1), '\0');
+        glGetProgramResourceName(ID, interface_type, index, length, nullptr, name.data());
+        name.resize(std::max(length - 1, 0)); // drop the terminating zero
+        return name;
+    };
+
+    GLint count = 0;
+    glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const GLenum props[] = { GL_BLOCK_INDEX, GL_LOCATION, GL_ARRAY_SIZE };
+        GLint values[3] = { -1, -1, 1 };
+        glGetProgramResourceiv(ID, GL_UNIFORM, i, 3, props, 3, nullptr, values);
+        if (values[0] != -1) continue; // member of a uniform block, has no location
+        std::string name = resourceName(GL_UNIFORM, i);
+        result->uniforms[name] = values[1];
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            // the elements of a default block array occupy consecutive locations
+            std::string base = name.substr(0, name.size() - 3);
+            result->uniforms[base] = values[1];
+            for (GLint element = 1; element < values[2]; ++element) {
+                result->uniforms[base + "[" + std::to_string(element) + "]"] = values[1] + element;
+            }
+        }
+    }
+
+    glGetProgramInterfaceiv(ID, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const GLenum prop = GL_LOCATION;
+        GLint location = -1;
+        glGetProgramResourceiv(ID, GL_PROGRAM_INPUT, i, 1, &prop, 1, nullptr, &location);
+        result->attributes[resourceName(GL_PROGRAM_INPUT, i)] = location;
+    }
+
+    const GLenum block_interfaces[2] = { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK };
+    for (GLenum interface_type : block_interfaces) {
+        auto& blocks = interface_type == GL_UNIFORM_BLOCK ? result->uniform_blocks : result->storage_blocks;
+        glGetProgramInterfaceiv(ID, interface_type, GL_ACTIVE_RESOURCES, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const GLenum prop = GL_BUFFER_BINDING;
+            GLint binding = -1;
+            glGetProgramResourceiv(ID, interface_type, i, 1, &prop, 1, nullptr, &binding);
+            blocks[resourceName(interface_type, i)] = binding;
+        }
+    }
+
+    reflection = std::move(result);
+}
+
+ShaderProgram::UniformHandle ShaderProgram::uniform(const std::string& name) const {
+    if (!reflection) return {};
+    auto it = reflection->uniforms.find(name);
+    return it != reflection->uniforms.end() ? UniformHandle{ it->second } : UniformHandle{};
+}
+
+GLint ShaderProgram::getAttribLocation(const std::string& name) const {
+    if (!reflection) return -1;
+    auto it = reflection->attributes.find(name);
+    return it != reflection->attributes.end() ? it->second : -1;
+}
+
+GLint ShaderProgram::getUniformBlockBinding(const std::string& name) const {
+    if (!reflection) return -1;
+    auto it = reflection->uniform_blocks.find(name);
+    return it != reflection->uniform_blocks.end() ? it->second : -1;
+}
+
+GLint ShaderProgram::getStorageBlockBinding(const std::string& name) const {
+    if (!reflection) return -1;
+    auto it = reflection->storage_blocks.find(name);
+    return it != reflection->storage_blocks.end() ? it->second : -1;
+}
+
+// Uniform setters by name, resolved through the reflection table
 void ShaderProgram::setUniform(const std::string& name, const float val) {
-    GLint loc = glGetUniformLocation(ID, name.c_str());
-    if (loc != -1) glUniform1f(loc, val);
+    setUniform(uniform(name), val);
 }
-// ... (Implement other setUniform methods similarly)
-// int
+
 void ShaderProgram::setUniform(const std::string& name, const int val) {
-    GLint loc = glGetUniformLocation(ID, name.c_str());
-    if (loc != -1) glUniform1i(loc, val);
+    setUniform(uniform(name), val);
 }
 
-// vec3
 void ShaderProgram::setUniform(const std::string& name, const glm::vec3 val) {
-    GLint loc = glGetUniformLocation(ID, name.c_str());
-    if (loc != -1) glUniform3f(loc, val.x, val.y, val.z);
+    setUniform(uniform(name), val);
 }
 
-// vec4
 void ShaderProgram::setUniform(const std::string& name, const glm::vec4 val) {
-    GLint loc = glGetUniformLocation(ID, name.c_str());
-    if (loc != -1) glUniform4f(loc, val.x, val.y, val.z, val.w);
+    setUniform(uniform(name), val);
 }
 
-// mat3
 void ShaderProgram::setUniform(const std::string& name, const glm::mat3 val) {
-    GLint loc = glGetUniformLocation(ID, name.c_str());
-    if (loc != -1) glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(val));
+    setUniform(uniform(name), val);
 }
 
-// mat4
 void ShaderProgram::setUniform(const std::string& name, const glm::mat4 val) {
-    GLint loc = glGetUniformLocation(ID, name.c_str());
-    if (loc != -1) glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(val));
-}
\ No newline at end of file
+    setUniform(uniform(name), val);
+}
+
+// Uniform setters with pre-resolved handles
+void ShaderProgram::setUniform(UniformHandle handle, const float val) const {
+    if (handle.valid()) glProgramUniform1f(ID, handle.location, val);
+}
+
+void ShaderProgram::setUniform(UniformHandle handle, const int val) const {
+    if (handle.valid()) glProgramUniform1i(ID, handle.location, val);
+}
+
+void ShaderProgram::setUniform(UniformHandle handle, const glm::vec3 val) const {
+    if (handle.valid()) glProgramUniform3f(ID, handle.location, val.x, val.y, val.z);
+}
+
+void ShaderProgram::setUniform(UniformHandle handle, const glm::vec4 val) const {
+    if (handle.valid()) glProgramUniform4f(ID, handle.location, val.x, val.y, val.z, val.w);
+}
+
+void ShaderProgram::setUniform(UniformHandle handle, const glm::mat3 val) const {
+    if (handle.valid()) glProgramUniformMatrix3fv(ID, handle.location, 1, GL_FALSE, glm::value_ptr(val));
+}
+
+void ShaderProgram::setUniform(UniformHandle handle, const glm::mat4 val) const {
+    if (handle.valid()) glProgramUniformMatrix4fv(ID, handle.location, 1, GL_FALSE, glm::value_ptr(val));
+}
+
+void ShaderProgram::setUniform(UniformHandle handle, const GLint* values, GLsizei count) const {
+    if (handle.valid() && count > 0) glProgramUniform1iv(ID, handle.location, count, values);
+}
+
+void ShaderProgram::setUniform(UniformHandle handle, const GLuint64 val) const {
+    if (handle.valid()) glProgramUniform2ui(ID, handle.location, static_cast<GLuint>(val), static_cast<GLuint>(val >> 32));
+}
@@ -3,23 +3,34 @@
 #include <GLFW/glfw3.h>
 #include <string>
 #include <filesystem>
+#include <memory>
+#include <unordered_map>
 #include <vector>
+#include "GLState.hpp"
 #include <GL/glew.h>
 #include <glm/glm.hpp>  // Pøidáváme include pro glm
 #include <glm/gtc/type_ptr.hpp>  // Pro glm::value_ptr
 
 class ShaderProgram {
 public:
+    // Pre-resolved uniform location, obtained once with uniform() and passed to the setters
+    struct UniformHandle {
+        GLint location{ -1 };
+        bool valid() const { return location >= 0; }
+    };
+
     // you can add more constructors for pipeline with GS, TS etc.
     ShaderProgram(void) = default; //does nothing
     ShaderProgram(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file); // TODO: implementation of load, compile, and link shader
+    explicit ShaderProgram(const std::filesystem::path& CS_file); // compute shader program
     // V ShaderProgram.hpp
-    void activate(void) const { glUseProgram(ID); };
-    void deactivate(void) const { glUseProgram(0); };
+    void activate(void) const { gl_state::useProgram(ID); };
+    void deactivate(void) const { gl_state::useProgram(0); };
     void clear(void) { 	//deallocate shader program
         deactivate();
-        glDeleteProgram(ID);
+        gl_state::deleteProgram(ID);
         ID = 0;
+        reflection.reset();
     }
     // Getter pro ID
     GLuint getID() const { return ID; }
@@ -31,8 +42,33 @@ public:
     void setUniform(const std::string& name, const glm::vec4 val);
     void setUniform(const std::string& name, const glm::mat3 val);
     void setUniform(const std::string& name, const glm::mat4 val);
+
+    // Program reflection, enumerated once after linking (no driver calls afterwards)
+    UniformHandle uniform(const std::string& name) const;
+    GLint getAttribLocation(const std::string& name) const;
+    GLint getUniformBlockBinding(const std::string& name) const;
+    GLint getStorageBlockBinding(const std::string& name) const;
+
+    // Setters with pre-resolved handles, invalid handles are ignored
+    void setUniform(UniformHandle handle, const float val) const;
+    void setUniform(UniformHandle handle, const int val) const;
+    void setUniform(UniformHandle handle, const glm::vec3 val) const;
+    void setUniform(UniformHandle handle, const glm::vec4 val) const;
+    void setUniform(UniformHandle handle, const glm::mat3 val) const;
+    void setUniform(UniformHandle handle, const glm::mat4 val) const;
+    void setUniform(UniformHandle handle, const GLint* values, GLsizei count) const; // int array
+    void setUniform(UniformHandle handle, const GLuint64 val) const; // uvec2 (bindless texture handle)
 private:
+    struct Reflection {
+        std::unordered_map<std::string, GLint> uniforms;       // location, arrays as "name" and as every "name[i]" up to the active size
+        std::unordered_map<std::string, GLint> attributes;     // location
+        std::unordered_map<std::string, GLint> uniform_blocks; // binding
+        std::unordered_map<std::string, GLint> storage_blocks; // binding
+    };
+
     GLuint ID{ 0 }; // default = 0, empty shader
+    std::shared_ptr<const Reflection> reflection; // shared by the copies of the program
+    void reflect();
     std::string getShaderInfoLog(const GLuint obj);
     std::string getProgramInfoLog(const GLuint obj);
     GLuint compile_shader(const std::filesystem::path& source_file, const GLenum type);
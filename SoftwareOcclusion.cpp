@@ -0,0 +1,249 @@
+#include "SoftwareOcclusion.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+void SoftwareOcclusion::setResolution(int w, int h) {
+    width = std::max(TILE_SIZE, w / TILE_SIZE * TILE_SIZE);
+    height = std::max(TILE_SIZE, h / TILE_SIZE * TILE_SIZE);
+    tiles_x = width / TILE_SIZE;
+    tiles_y = height / TILE_SIZE;
+    depth.clear();
+    tile_depth.clear();
+}
+
+void SoftwareOcclusion::beginFrame(const glm::mat4& vp) {
+    view_projection = vp;
+    occluders.clear();
+    triangle_count = 0;
+    tested = 0;
+    culled = 0;
+}
+
+void SoftwareOcclusion::addOccluder(const Model* model) {
+    occluders.push_back(model);
+}
+
+void SoftwareOcclusion::rasterize() {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    depth.assign(static_cast<size_t>(width) * height, 1.0f);
+    tile_depth.assign(static_cast<size_t>(tiles_x) * tiles_y, 1.0f);
+    worker_triangles.resize(parallel_worker_count());
+    for (auto& list : worker_triangles) list.clear();
+
+    // Transform and set up all occluder triangles
+    for (const Model* model : occluders) {
+        glm::mat4 mvp = view_projection * model->getModelMatrix();
+        for (const auto& mesh : model->meshes) {
+            if (mesh.primitive_type != GL_TRIANGLES || mesh.indices.empty()) continue;
+            clip_vertices.resize(mesh.vertices.size());
+            parallel_for(0, static_cast<int>(mesh.vertices.size()), [&](int i) {
+                clip_vertices[i] = mvp * glm::vec4(mesh.vertices[i].position, 1.0f);
+            }, 1024);
+            setupTriangles(mesh.indices);
+        }
+    }
+    triangle_count = 0;
+    for (const auto& list : worker_triangles) triangle_count += list.size();
+
+    // Every worker owns a band of whole tile rows, so no two workers write the same pixel
+    parallel_chunks(0, tiles_y, [&](int, int from, int to) {
+        rasterizeBand(from * TILE_SIZE, to * TILE_SIZE);
+    }, 1);
+    buildTileDepth();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    raster_ms = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void SoftwareOcclusion::setupTriangles(const std::vector<GLuint>& indices) {
+    int count = static_cast<int>(indices.size() / 3);
+    parallel_chunks(0, count, [&](int worker, int from, int to) {
+        std::vector<Triangle>& out = worker_triangles[worker];
+        for (int t = from; t < to; ++t) {
+            addTriangle(out, clip_vertices[indices[t * 3]],
+                clip_vertices[indices[t * 3 + 1]],
+                clip_vertices[indices[t * 3 + 2]]);
+        }
+    }, 256);
+}
+
+void SoftwareOcclusion::addTriangle(std::vector<Triangle>& out, const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2) const {
+    // Trivial reject against the side and far planes
+    if ((v0.x > v0.w && v1.x > v1.w && v2.x > v2.w) || (v0.x < -v0.w && v1.x < -v1.w && v2.x < -v2.w) ||
+        (v0.y > v0.w && v1.y > v1.w && v2.y > v2.w) || (v0.y < -v0.w && v1.y < -v1.w && v2.y < -v2.w) ||
+        (v0.z > v0.w && v1.z > v1.w && v2.z > v2.w)) {
+        return;
+    }
+
+    // Clip against the near plane (z = -w), leaves a triangle or a quad
+    const glm::vec4 in[3] = { v0, v1, v2 };
+    glm::vec4 poly[4];
+    int n = 0;
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec4& a = in[i];
+        const glm::vec4& b = in[(i + 1) % 3];
+        float da = a.z + a.w;
+        float db = b.z + b.w;
+        if (da >= 0.0f) poly[n++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f)) poly[n++] = a + (b - a) * (da / (da - db));
+    }
+
+    for (int k = 1; k + 1 < n; ++k) {
+        glm::vec3 p[3];
+        const glm::vec4* src[3] = { &poly[0], &poly[k], &poly[k + 1] };
+        for (int i = 0; i < 3; ++i) {
+            float inv_w = 1.0f / src[i]->w;
+            // snapped to 1/8 pixel, edge functions of on-screen triangles are then exact in float
+            // and shared edges leave no holes
+            p[i] = glm::vec3(std::round((src[i]->x * inv_w * 0.5f + 0.5f) * width * 8.0f) * 0.125f,
+                std::round((src[i]->y * inv_w * 0.5f + 0.5f) * height * 8.0f) * 0.125f,
+                src[i]->z * inv_w * 0.5f + 0.5f);
+        }
+
+        float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+        if (std::abs(area) < 1e-6f) continue;
+        if (area < 0.0f) {
+            // both faces occlude, only the edge orientation has to be consistent
+            std::swap(p[1], p[2]);
+            area = -area;
+        }
+
+        Triangle tri;
+        tri.min_x = std::max(0, static_cast<int>(std::floor(std::min({ p[0].x, p[1].x, p[2].x }))));
+        tri.max_x = std::min(width - 1, static_cast<int>(std::floor(std::max({ p[0].x, p[1].x, p[2].x }))));
+        tri.min_y = std::max(0, static_cast<int>(std::floor(std::min({ p[0].y, p[1].y, p[2].y }))));
+        tri.max_y = std::min(height - 1, static_cast<int>(std::floor(std::max({ p[0].y, p[1].y, p[2].y }))));
+        if (tri.min_x > tri.max_x || tri.min_y > tri.max_y) continue;
+
+        // Edge i is opposite to vertex i, so edge_i(pixel) / area is the barycentric weight of vertex i
+        float inv_area = 1.0f / area;
+        tri.depth_a = tri.depth_b = tri.depth_c = 0.0f;
+        for (int i = 0; i < 3; ++i) {
+            const glm::vec3& a = p[(i + 1) % 3];
+            const glm::vec3& b = p[(i + 2) % 3];
+            tri.edge_a[i] = a.y - b.y;
+            tri.edge_b[i] = b.x - a.x;
+            tri.edge_c[i] = -(tri.edge_a[i] * a.x + tri.edge_b[i] * a.y);
+            tri.depth_a += tri.edge_a[i] * p[i].z * inv_area;
+            tri.depth_b += tri.edge_b[i] * p[i].z * inv_area;
+            tri.depth_c += tri.edge_c[i] * p[i].z * inv_area;
+        }
+        out.push_back(tri);
+    }
+}
+
+void SoftwareOcclusion::rasterizeBand(int row_begin, int row_end) {
+    for (const auto& list : worker_triangles) {
+        for (const Triangle& tri : list) {
+            if (tri.max_y < row_begin || tri.min_y >= row_end) continue;
+            int y_from = std::max(tri.min_y, row_begin);
+            int y_to = std::min(tri.max_y, row_end - 1);
+            int x_from = tri.min_x & ~3;
+
+            for (int y = y_from; y <= y_to; ++y) {
+                float fy = y + 0.5f;
+                float* row = depth.data() + static_cast<size_t>(y) * width;
+                float e_row[3], z_row = tri.depth_b * fy + tri.depth_c;
+                for (int i = 0; i < 3; ++i) e_row[i] = tri.edge_b[i] * fy + tri.edge_c[i];
+#if defined(OCCLUSION_SSE)
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+                for (int x = x_from; x <= tri.max_x; x += 4) {
+                    __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane);
+                    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for (int i = 0; i < 3; ++i) {
+                        __m128 e = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(tri.edge_a[i])), _mm_set1_ps(e_row[i]));
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(e, zero));
+                    }
+                    if (_mm_movemask_ps(inside) == 0) continue;
+                    __m128 z = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(tri.depth_a)), _mm_set1_ps(z_row));
+                    __m128 d = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(d, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, d)));
+                }
+#else
+                for (int x = x_from; x <= tri.max_x; ++x) {
+                    float px = x + 0.5f;
+                    if (tri.edge_a[0] * px + e_row[0] < 0.0f || tri.edge_a[1] * px + e_row[1] < 0.0f ||
+                        tri.edge_a[2] * px + e_row[2] < 0.0f) {
+                        continue;
+                    }
+                    row[x] = std::min(row[x], tri.depth_a * px + z_row);
+                }
+#endif
+            }
+        }
+    }
+}
+
+void SoftwareOcclusion::buildTileDepth() {
+    parallel_for(0, tiles_y, [&](int ty) {
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            float farthest = 0.0f;
+            for (int y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; ++y) {
+                const float* row = depth.data() + static_cast<size_t>(y) * width + tx * TILE_SIZE;
+                for (int x = 0; x < TILE_SIZE; ++x) farthest = std::max(farthest, row[x]);
+            }
+            tile_depth[static_cast<size_t>(ty) * tiles_x + tx] = farthest;
+        }
+    }, 4);
+}
+
+bool SoftwareOcclusion::isBoxVisible(const glm::vec3& box_min, const glm::vec3& box_max) const {
+    if (depth.empty()) return true;
+
+    // Screen rectangle and nearest depth of the projected box
+    float min_x = 1e30f, min_y = 1e30f, max_x = -1e30f, max_y = -1e30f, nearest = 1.0f;
+    for (int i = 0; i < 8; ++i) {
+        glm::vec4 c = view_projection * glm::vec4((i & 1) ? box_max.x : box_min.x,
+            (i & 2) ? box_max.y : box_min.y, (i & 4) ? box_max.z : box_min.z, 1.0f);
+        if (c.z < -c.w || c.w <= 1e-5f) return true; // crosses the near plane
+        float inv_w = 1.0f / c.w;
+        float sx = (c.x * inv_w * 0.5f + 0.5f) * width;
+        float sy = (c.y * inv_w * 0.5f + 0.5f) * height;
+        min_x = std::min(min_x, sx); max_x = std::max(max_x, sx);
+        min_y = std::min(min_y, sy); max_y = std::max(max_y, sy);
+        nearest = std::min(nearest, c.z * inv_w * 0.5f + 0.5f);
+    }
+
+    int x0 = std::max(0, static_cast<int>(std::floor(min_x)));
+    int x1 = std::min(width - 1, static_cast<int>(std::floor(max_x)));
+    int y0 = std::max(0, static_cast<int>(std::floor(min_y)));
+    int y1 = std::min(height - 1, static_cast<int>(std::floor(max_y)));
+    if (x0 > x1 || y0 > y1) return true; // off screen, left to the frustum test
+
+    // Tiles whose farthest occluder is in front of the box are hidden as a whole,
+    // the remaining ones are checked per pixel
+    for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ++ty) {
+        for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; ++tx) {
+            if (tile_depth[static_cast<size_t>(ty) * tiles_x + tx] < nearest) continue;
+            int py_end = std::min(y1, (ty + 1) * TILE_SIZE - 1);
+            int px_end = std::min(x1, (tx + 1) * TILE_SIZE - 1);
+            for (int y = std::max(y0, ty * TILE_SIZE); y <= py_end; ++y) {
+                const float* row = depth.data() + static_cast<size_t>(y) * width;
+                for (int x = std::max(x0, tx * TILE_SIZE); x <= px_end; ++x) {
+                    if (row[x] >= nearest) return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void SoftwareOcclusion::cull(const std::vector<Model*>& candidates, std::vector<Model*>& visible) {
+    for (Model* model : candidates) {
+        glm::vec3 bmin, bmax;
+        model->getWorldBounds(bmin, bmax);
+        if (isBoxVisible(bmin, bmax)) visible.push_back(model);
+        else culled++;
+    }
+    tested += candidates.size();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Model.hpp"
+
+// Occlusion culling with a small software depth buffer, no GPU readback involved.
+// Occluder triangles (maze wall chunks, big props) are rasterized every frame into a low resolution
+// depth buffer in horizontal bands, one band per worker thread, 4 pixels at a time with SSE.
+// A max-depth tile level on top of it (hierarchical depth) lets most bounds tests finish on a few tiles.
+class SoftwareOcclusion {
+public:
+    // Width must be a multiple of TILE_SIZE
+    void setResolution(int width, int height);
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Starts a new frame: clears the occluder list, depth is rasterized by rasterize()
+    void beginFrame(const glm::mat4& view_projection);
+    // Model whose triangles (GL_TRIANGLES meshes) hide what is behind them
+    void addOccluder(const Model* model);
+    void rasterize();
+
+    // false when the box is completely behind the rasterized occluders
+    bool isBoxVisible(const glm::vec3& box_min, const glm::vec3& box_max) const;
+    // Appends the not occluded objects of candidates to visible (in the original order)
+    void cull(const std::vector<Model*>& candidates, std::vector<Model*>& visible);
+
+    const std::vector<float>& getDepth() const { return depth; }
+
+    // Statistics of the current frame
+    size_t getOccluderTriangles() const { return triangle_count; }
+    size_t getTested() const { return tested; }
+    size_t getCulled() const { return culled; }
+    double getRasterTimeMs() const { return raster_ms; }
+
+    static constexpr int TILE_SIZE = 8;
+
+private:
+    // Screen space triangle ready for rasterization: edge and depth planes in pixel coordinates
+    struct Triangle {
+        float edge_a[3], edge_b[3], edge_c[3];
+        float depth_a, depth_b, depth_c;
+        int min_x, max_x, min_y, max_y;
+    };
+
+    int width = 320;
+    int height = 192;
+    int tiles_x = 40;
+    int tiles_y = 24;
+    glm::mat4 view_projection{ 1.0f };
+
+    std::vector<const Model*> occluders;
+    std::vector<float> depth;      // nearest occluder depth per pixel, 1 = nothing
+    std::vector<float> tile_depth; // farthest depth of every TILE_SIZE x TILE_SIZE tile
+    std::vector<glm::vec4> clip_vertices;
+    std::vector<std::vector<Triangle>> worker_triangles;
+
+    size_t triangle_count = 0;
+    size_t tested = 0;
+    size_t culled = 0;
+    double raster_ms = 0.0;
+
+    void setupTriangles(const std::vector<GLuint>& indices);
+    void addTriangle(std::vector<Triangle>& out, const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2) const;
+    void rasterizeBand(int row_begin, int row_end);
+    void buildTileDepth();
+};
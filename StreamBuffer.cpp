@@ -0,0 +1,133 @@
+#include "StreamBuffer.hpp"
+#include "GpuAllocator.hpp"
+#include <algorithm>
+#include <iostream>
+
+static GLsizeiptr alignUp(GLsizeiptr value, GLsizeiptr alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+StreamBuffer::StreamBuffer(GLsizeiptr frame_size) : frame_size(frame_size) {
+}
+
+void StreamBuffer::create(GLsizeiptr new_frame_size) {
+    if (buffer != 0) {
+        // allocations of this frame still point into it
+        retired.push_back({ buffer, nullptr });
+        for (GLsync& fence : fences) {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    frame_size = new_frame_size;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, frame_size * FRAMES, nullptr, flags);
+    mapped = static_cast<char*>(glMapNamedBufferRange(buffer, 0, frame_size * FRAMES, flags));
+    if (mapped == nullptr) {
+        std::cerr << "StreamBuffer: failed to map " << frame_size * FRAMES << " bytes" << std::endl;
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    head = 0;
+}
+
+void StreamBuffer::beginFrame() {
+    frame = (frame + 1) % FRAMES;
+    head = 0;
+    allocation_count = 0;
+    if (GLsync fence = fences[frame]) {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            waits++;
+            do {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        fences[frame] = nullptr;
+    }
+
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [](Retired& old) {
+        if (old.fence == nullptr || glClientWaitSync(old.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            return false;
+        }
+        glDeleteSync(old.fence);
+        glDeleteBuffers(1, &old.buffer);
+        return true;
+    }), retired.end());
+}
+
+void StreamBuffer::endFrame() {
+    if (buffer == 0) {
+        return;
+    }
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    fences[frame] = fence;
+    for (Retired& old : retired) {
+        if (old.fence == nullptr) old.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment) {
+    if (size <= 0) {
+        return {};
+    }
+    GLsizeiptr default_alignment = std::max<GLsizeiptr>(gpu_memory::bufferOffsetAlignment(), 16);
+    if (alignment == 0) {
+        alignment = default_alignment;
+    }
+
+    GLsizeiptr start = alignUp(head, alignment);
+    if (buffer == 0 || start + size > frame_size) {
+        GLsizeiptr needed = buffer == 0 ? size : start + size;
+        GLsizeiptr new_size = buffer == 0 ? frame_size : frame_size * 2;
+        while (new_size < needed) new_size *= 2;
+        if (buffer != 0) {
+            std::cout << "StreamBuffer: growing to " << new_size * FRAMES / 1024 << " KB" << std::endl;
+        }
+        create(alignUp(new_size, default_alignment));
+        if (buffer == 0) {
+            return {};
+        }
+        start = 0;
+    }
+
+    Allocation allocation;
+    allocation.buffer = buffer;
+    allocation.offset = static_cast<GLintptr>(frame) * frame_size + start;
+    allocation.size = size;
+    allocation.data = mapped + allocation.offset;
+    head = start + size;
+    allocation_count++;
+    return allocation;
+}
+
+void StreamBuffer::cleanup() {
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    for (Retired& old : retired) {
+        if (old.fence) glDeleteSync(old.fence);
+        glDeleteBuffers(1, &old.buffer);
+    }
+    retired.clear();
+    if (buffer != 0) {
+        glUnmapNamedBuffer(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = nullptr;
+    head = 0;
+    allocation_count = 0;
+}
+
+StreamBuffer::Stats StreamBuffer::getStats() const {
+    Stats stats;
+    stats.capacity = buffer != 0 ? frame_size * FRAMES : 0;
+    stats.used = head;
+    stats.allocations = allocation_count;
+    stats.waits = waits;
+    return stats;
+}
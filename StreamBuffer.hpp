@@ -0,0 +1,61 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// Ring of FRAMES regions in one persistently and coherently mapped buffer (glNamedBufferStorage with
+// GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT) for data written once per frame. allocate() hands out the next
+// range of the current frame's region, the caller writes it through the pointer, no GL call is made.
+// endFrame() puts a fence behind the frame, beginFrame() waits for the fence of the region it is about to
+// reuse, so the CPU runs at most FRAMES - 1 frames ahead of the GPU.
+// A frame that does not fit moves the ring to a buffer twice as big, the old one is deleted once the GPU is done.
+class StreamBuffer {
+public:
+    static constexpr int FRAMES = 3;
+
+    struct Allocation {
+        GLuint buffer = 0;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+        void* data = nullptr; // mapped, valid until the region comes around again
+        explicit operator bool() const { return data != nullptr; }
+    };
+
+    struct Stats {
+        GLsizeiptr capacity = 0;   // bytes in all regions
+        GLsizeiptr used = 0;       // bytes allocated in the current frame
+        size_t allocations = 0;    // in the current frame
+        size_t waits = 0;          // frames that had to wait for the GPU
+    };
+
+    explicit StreamBuffer(GLsizeiptr frame_size);
+    ~StreamBuffer() = default;
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    void beginFrame();
+    void endFrame();
+    // Empty allocation for size 0. alignment 0 is the UBO / SSBO offset alignment, enough for any use.
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 0);
+    void cleanup();
+
+    Stats getStats() const;
+
+private:
+    struct Retired {
+        GLuint buffer = 0;
+        GLsync fence = nullptr; // placed by the endFrame() after the buffer was replaced
+    };
+
+    GLsizeiptr frame_size;
+    GLuint buffer = 0;
+    char* mapped = nullptr;
+    GLsync fences[FRAMES] = {};
+    std::vector<Retired> retired;
+    int frame = 0;
+    GLsizeiptr head = 0; // next free byte of the current region
+    size_t allocation_count = 0;
+    size_t waits = 0;
+
+    void create(GLsizeiptr new_frame_size);
+};
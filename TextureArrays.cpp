@@ -0,0 +1,95 @@
+#include "TextureArrays.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+void TextureArrays::init(ShaderProgram& shader) {
+    GLint units[MAX_ARRAYS];
+    for (int i = 0; i < MAX_ARRAYS; ++i) units[i] = FIRST_UNIT + i;
+    shader.setUniform(shader.uniform("uTextureArrays"), units, MAX_ARRAYS);
+}
+
+void TextureArrays::cleanup() {
+    if (bindless) {
+        for (auto& [texture, entry] : entries) glMakeTextureHandleNonResidentARB(entry.handle);
+    }
+    gl_state::deleteTextures(static_cast<GLsizei>(arrays.size()), arrays.data());
+    arrays.clear();
+    entries.clear();
+    bindless = false;
+}
+
+void TextureArrays::build(const std::vector<GLuint>& textures, bool allow_bindless) {
+    if (allow_bindless && GLEW_ARB_bindless_texture && arrays.empty()) {
+        bindless = true;
+        for (GLuint texture : textures) {
+            if (texture == 0 || entries.count(texture)) continue;
+            GLuint64 handle = glGetTextureHandleARB(texture);
+            glMakeTextureHandleResidentARB(handle);
+            entries[texture].handle = handle;
+        }
+        std::cout << "TextureArrays: " << entries.size() << " bindless textures" << std::endl;
+        return;
+    }
+
+    // group by size, format and mip levels (the atlas limits its levels)
+    using Key = std::tuple<GLint, GLint, GLint, GLint>;
+    std::map<Key, std::vector<GLuint>> groups;
+    for (GLuint texture : textures) {
+        if (texture == 0 || entries.count(texture)) continue;
+        GLint width = 0, height = 0, format = 0, max_level = 1000;
+        glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        glGetTextureParameteriv(texture, GL_TEXTURE_MAX_LEVEL, &max_level);
+        std::vector<GLuint>& group = groups[{ width, height, format, max_level }];
+        if (std::find(group.begin(), group.end(), texture) == group.end()) group.push_back(texture);
+    }
+
+    GLint max_layers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    // biggest groups first, they save the most binds
+    std::vector<std::pair<Key, std::vector<GLuint>>> ordered(groups.begin(), groups.end());
+    std::stable_sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) { return a.second.size() > b.second.size(); });
+    for (auto& [key, group] : ordered) {
+        auto [width, height, format, max_level] = key;
+        for (size_t first = 0; first < group.size() && arrays.size() < MAX_ARRAYS; first += max_layers) {
+            GLsizei layers = static_cast<GLsizei>(std::min<size_t>(group.size() - first, max_layers));
+            GLsizei levels = 1 + static_cast<GLsizei>(std::floor(std::log2(static_cast<float>(std::max(width, height)))));
+            levels = std::min(levels, max_level + 1);
+            GLuint array = 0;
+            glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array);
+            glTextureStorage3D(array, levels, format, width, height, layers);
+            for (GLsizei layer = 0; layer < layers; ++layer) {
+                GLuint texture = group[first + layer];
+                glCopyImageSubData(texture, GL_TEXTURE_2D, 0, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1);
+                entries[texture] = { static_cast<GLint>(arrays.size()), layer, 0 };
+            }
+            // same sampling as App::gen_tex
+            glTextureParameteri(array, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(array, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTextureParameteri(array, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTextureParameteri(array, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glGenerateTextureMipmap(array);
+            arrays.push_back(array);
+        }
+    }
+    std::cout << "TextureArrays: " << entries.size() << " textures in " << arrays.size() << " arrays" << std::endl;
+}
+
+void TextureArrays::apply(Material& material) const {
+    auto found = entries.find(material.texture_id);
+    Entry entry = found != entries.end() ? found->second : Entry();
+    material.texture_array = entry.array;
+    material.texture_layer = entry.layer;
+    material.texture_handle = entry.handle;
+}
+
+void TextureArrays::bind() const {
+    if (!arrays.empty()) {
+        gl_state::bindTextures(FIRST_UNIT, static_cast<GLsizei>(arrays.size()), arrays.data());
+    }
+}
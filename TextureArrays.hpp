@@ -0,0 +1,43 @@
+#pragma once
+#include <GL/glew.h>
+#include <unordered_map>
+#include <vector>
+#include "Material.hpp"
+#include "ShaderProgram.hpp"
+
+// Removes the per-draw texture binds of the tex program.
+// Textures of the same size and format are copied into GL_TEXTURE_2D_ARRAYs (with a full mip chain),
+// the arrays are bound once per frame to consecutive units and tex.frag picks array and layer per draw
+// (the record of the material in the material buffer). Where ARB_bindless_texture is available
+// (and allowed) every texture gets a resident handle instead and nothing is bound at all.
+// Textures that fit in neither keep the classic tex0 binding.
+class TextureArrays {
+public:
+    static constexpr int MAX_ARRAYS = 8;      // must match MAX_TEXTURE_ARRAYS in tex.frag
+    static constexpr GLuint FIRST_UNIT = 8;   // units FIRST_UNIT .. FIRST_UNIT + MAX_ARRAYS - 1
+
+    void init(ShaderProgram& shader);
+    void cleanup();
+
+    // Builds the arrays (or handles) for the textures, textures already built are ignored
+    void build(const std::vector<GLuint>& textures, bool allow_bindless);
+    // Sets the texture source of the material (array and layer or handle) from its texture_id
+    void apply(Material& material) const;
+    // Binds all arrays with one call, once per frame
+    void bind() const;
+
+    bool isBindless() const { return bindless; }
+    size_t getArrayCount() const { return arrays.size(); }
+    size_t getTextureCount() const { return entries.size(); }
+
+private:
+    struct Entry {
+        GLint array = -1;  // index into arrays
+        GLint layer = -1;
+        GLuint64 handle = 0;
+    };
+
+    std::unordered_map<GLuint, Entry> entries;
+    std::vector<GLuint> arrays;
+    bool bindless = false;
+};
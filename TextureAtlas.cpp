@@ -0,0 +1,268 @@
+#include "TextureAtlas.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// private copy of the packer, imgui_draw.cpp compiles its own static one
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+namespace {
+    constexpr char ATLAS_MAGIC[4] = { 'A', 'T', 'L', '1' };
+
+    std::vector<std::filesystem::path> listImages(const std::filesystem::path& directory) {
+        std::vector<std::filesystem::path> images;
+        std::error_code ec;
+        for (const auto& item : std::filesystem::directory_iterator(directory, ec)) {
+            if (!item.is_regular_file()) continue;
+            std::string extension = item.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+            if (extension == ".png" || extension == ".jpg" || extension == ".jpeg") {
+                images.push_back(item.path());
+            }
+        }
+        std::sort(images.begin(), images.end());
+        return images;
+    }
+}
+
+uint64_t TextureAtlas::hashDirectory(const std::filesystem::path& directory) {
+    // FNV-1a over the packing parameters and name, size and modification time of every image
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
+    mix(MAX_IMAGE_SIZE);
+    mix(MAX_ATLAS_SIZE);
+    mix(GUTTER);
+    mix(MAX_LEVEL); // cell alignment of the layout
+    for (const auto& path : listImages(directory)) {
+        for (char c : path.filename().string()) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        std::error_code ec;
+        mix(static_cast<uint64_t>(std::filesystem::file_size(path, ec)));
+        mix(static_cast<uint64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count()));
+    }
+    return hash;
+}
+
+void TextureAtlas::loadOrBuild(const std::filesystem::path& directory, const std::filesystem::path& cache_file) {
+    this->directory = directory;
+    uint64_t expected_hash = hashDirectory(directory);
+    cv::Mat pixels;
+    if (load(cache_file, expected_hash, pixels)) {
+        std::cout << "Texture atlas loaded from cache " << cache_file << " (" << entries.size() << " images)" << std::endl;
+    }
+    else {
+        build(directory, pixels);
+        hash = expected_hash;
+        std::cout << "Texture atlas " << size << "x" << size << " packed from " << entries.size() << " images in "
+            << build_time_ms << " ms" << std::endl;
+        if (!pixels.empty() && !save(cache_file, pixels)) {
+            std::cerr << "Failed to write texture atlas cache: " << cache_file << std::endl;
+        }
+    }
+    if (!pixels.empty()) {
+        upload(pixels);
+    }
+}
+
+void TextureAtlas::build(const std::filesystem::path& directory, cv::Mat& pixels) {
+    auto start = std::chrono::high_resolution_clock::now();
+    entries.clear();
+    size = 0;
+
+    struct Source {
+        std::string name;
+        cv::Mat image;
+    };
+    std::vector<Source> sources;
+    for (const auto& path : listImages(directory)) {
+        cv::Mat image = cv::imread(path.string(), cv::IMREAD_UNCHANGED);
+        if (image.empty() || image.cols > MAX_IMAGE_SIZE || image.rows > MAX_IMAGE_SIZE) continue;
+        if (image.depth() != CV_8U) {
+            image.convertTo(image, CV_8U, 1.0 / 256.0);
+        }
+        switch (image.channels()) {
+        case 1: cv::cvtColor(image, image, cv::COLOR_GRAY2BGRA); break;
+        case 3: cv::cvtColor(image, image, cv::COLOR_BGR2BGRA); break;
+        case 4: break;
+        default: continue;
+        }
+        sources.push_back({ path.filename().string(), image });
+    }
+    if (sources.empty()) {
+        return;
+    }
+
+    // smallest power of two square that holds every image with its gutter. Packing runs on a grid of
+    // CELL = 2^MAX_LEVEL pixels, so every rectangle starts and ends on a texel border of the coarsest level
+    // and no texel of any used level is shared by two images.
+    std::vector<stbrp_rect> rects(sources.size());
+    for (size = 256;; size *= 2) {
+        for (size_t i = 0; i < sources.size(); ++i) {
+            rects[i] = {};
+            rects[i].id = static_cast<int>(i);
+            rects[i].w = (sources[i].image.cols + 2 * GUTTER + CELL - 1) / CELL;
+            rects[i].h = (sources[i].image.rows + 2 * GUTTER + CELL - 1) / CELL;
+        }
+        std::vector<stbrp_node> nodes(size / CELL);
+        stbrp_context context;
+        stbrp_init_target(&context, size / CELL, size / CELL, nodes.data(), static_cast<int>(nodes.size()));
+        if (stbrp_pack_rects(&context, rects.data(), static_cast<int>(rects.size())) || size >= MAX_ATLAS_SIZE) {
+            break;
+        }
+    }
+    for (stbrp_rect& rect : rects) {
+        rect.x *= CELL;
+        rect.y *= CELL;
+        rect.w *= CELL;
+        rect.h *= CELL;
+    }
+
+    pixels = cv::Mat(size, size, CV_8UC4, cv::Scalar(0, 0, 0, 0));
+    for (const stbrp_rect& rect : rects) {
+        const Source& source = sources[rect.id];
+        if (!rect.was_packed) {
+            std::cerr << "Texture atlas: no room for " << source.name << std::endl;
+            continue;
+        }
+        // the gutter (and the padding up to the cell grid) continues the image from its opposite edge,
+        // as GL_REPEAT would
+        cv::Mat bordered;
+        cv::copyMakeBorder(source.image, bordered, GUTTER, rect.h - GUTTER - source.image.rows,
+            GUTTER, rect.w - GUTTER - source.image.cols, cv::BORDER_WRAP);
+        bordered.copyTo(pixels(cv::Rect(rect.x, rect.y, rect.w, rect.h)));
+        entries.push_back({ source.name, rect.x + GUTTER, rect.y + GUTTER, source.image.cols, source.image.rows });
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    build_time_ms = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void TextureAtlas::upload(const cv::Mat& pixels) {
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureStorage2D(texture, MAX_LEVEL + 1, GL_RGBA8, size, size);
+    glTextureSubImage2D(texture, 0, 0, 0, size, size, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAX_LEVEL, MAX_LEVEL); // coarser levels would mix neighbouring images
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenerateTextureMipmap(texture);
+}
+
+void TextureAtlas::cleanup() {
+    // the views belong to whoever asked for them
+    gl_state::deleteTextures(1, &texture);
+    texture = 0;
+    size = 0;
+    entries.clear();
+    views.clear();
+}
+
+GLuint TextureAtlas::createView(const std::filesystem::path& path) {
+    if (texture == 0 || path.parent_path().lexically_normal() != directory.lexically_normal()) {
+        return 0;
+    }
+    std::string name = path.filename().string();
+    auto found = std::find_if(entries.begin(), entries.end(), [&](const Entry& entry) { return entry.name == name; });
+    if (found == entries.end()) {
+        return 0;
+    }
+    GLuint view = 0;
+    glGenTextures(1, &view);
+    glTextureView(view, GL_TEXTURE_2D, texture, GL_RGBA8, 0, MAX_LEVEL + 1, 0, 1);
+    views[view] = static_cast<size_t>(found - entries.begin());
+    return view;
+}
+
+void TextureAtlas::apply(Material& material) const {
+    auto found = views.find(material.texture_id);
+    if (found == views.end()) {
+        return;
+    }
+    const Entry& entry = entries[found->second];
+    float scale = 1.0f / static_cast<float>(size);
+    material.texture_id = texture;
+    material.texture_rect = glm::vec4(entry.x, entry.y, entry.width, entry.height) * scale;
+}
+
+bool TextureAtlas::save(const std::filesystem::path& cache_file, const cv::Mat& pixels) const {
+    std::error_code ec;
+    if (cache_file.has_parent_path()) {
+        std::filesystem::create_directories(cache_file.parent_path(), ec);
+    }
+    std::ofstream file(cache_file, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    int32_t header[2] = { size, static_cast<int32_t>(entries.size()) };
+    file.write(ATLAS_MAGIC, sizeof(ATLAS_MAGIC));
+    file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const Entry& entry : entries) {
+        int32_t record[5] = { static_cast<int32_t>(entry.name.size()), entry.x, entry.y, entry.width, entry.height };
+        file.write(reinterpret_cast<const char*>(record), sizeof(record));
+        file.write(entry.name.data(), entry.name.size());
+    }
+    file.write(reinterpret_cast<const char*>(pixels.data), static_cast<std::streamsize>(pixels.total() * pixels.elemSize()));
+    return file.good();
+}
+
+bool TextureAtlas::load(const std::filesystem::path& cache_file, uint64_t expected_hash, cv::Mat& pixels) {
+    std::ifstream file(cache_file, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    char magic[4];
+    uint64_t cached_hash = 0;
+    int32_t header[2];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&cached_hash), sizeof(cached_hash));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || std::memcmp(magic, ATLAS_MAGIC, sizeof(magic)) != 0 || cached_hash != expected_hash ||
+        header[0] <= 0 || header[0] > MAX_ATLAS_SIZE) {
+        std::cout << "Texture atlas cache " << cache_file << " is stale, rebuilding" << std::endl;
+        return false;
+    }
+
+    std::vector<Entry> cached(std::max(header[1], 0));
+    for (Entry& entry : cached) {
+        int32_t record[5];
+        file.read(reinterpret_cast<char*>(record), sizeof(record));
+        if (!file || record[0] < 0 || record[0] > 4096) {
+            return false;
+        }
+        entry.name.resize(record[0]);
+        file.read(entry.name.data(), record[0]);
+        entry.x = record[1];
+        entry.y = record[2];
+        entry.width = record[3];
+        entry.height = record[4];
+    }
+    cv::Mat cached_pixels(header[0], header[0], CV_8UC4);
+    file.read(reinterpret_cast<char*>(cached_pixels.data), static_cast<std::streamsize>(cached_pixels.total() * cached_pixels.elemSize()));
+    if (!file) {
+        return false;
+    }
+
+    size = header[0];
+    hash = cached_hash;
+    entries = std::move(cached);
+    pixels = cached_pixels;
+    build_time_ms = 0.0;
+    return true;
+}
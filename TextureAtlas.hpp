@@ -0,0 +1,60 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "Material.hpp"
+
+// Packs the small images of a texture directory into one RGBA8 atlas (skyline packer of the vendored
+// imstb_rectpack.h) and caches the packed pixels on disk, so startup uploads one texture instead of decoding
+// and uploading every image. Every image gets a GUTTER wide border copied from its opposite side and is packed
+// on a grid of CELL pixels, so repeating and mipmapped sampling up to MAX_LEVEL stays inside the image. tex.frag wraps the UVs into the image rectangle
+// (Material::texture_rect) and samples with the gradients of the untransformed UVs.
+class TextureAtlas {
+public:
+    static constexpr int MAX_IMAGE_SIZE = 512;   // larger images keep their own texture
+    static constexpr int MAX_ATLAS_SIZE = 4096;
+    static constexpr int GUTTER = 8;             // covers mip levels 0 .. MAX_LEVEL
+    static constexpr int MAX_LEVEL = 3;
+    static constexpr int CELL = 1 << MAX_LEVEL;  // packing grid, one texel of level MAX_LEVEL
+    static_assert(GUTTER >= CELL, "the gutter must cover one texel of the coarsest level");
+
+    // Loads the atlas from cache_file when the images of directory did not change, otherwise packs and writes it
+    void loadOrBuild(const std::filesystem::path& directory, const std::filesystem::path& cache_file);
+    void cleanup();
+
+    // Texture standing for an image of the atlas (a view of the whole atlas), 0 when the image is not in it.
+    // The caller owns it like any other texture, apply() swaps it for the atlas itself.
+    GLuint createView(const std::filesystem::path& path);
+    // Materials textured with a view: texture_id becomes the atlas, texture_rect the image rectangle
+    void apply(Material& material) const;
+
+    GLuint getTexture() const { return texture; }
+    size_t getImageCount() const { return entries.size(); }
+    int getSize() const { return size; }
+    double getBuildTimeMs() const { return build_time_ms; }
+
+    static uint64_t hashDirectory(const std::filesystem::path& directory);
+
+private:
+    struct Entry {
+        std::string name; // file name inside the directory
+        int32_t x = 0, y = 0, width = 0, height = 0; // image without the gutter, in atlas pixels
+    };
+
+    std::filesystem::path directory;
+    GLuint texture = 0;
+    int32_t size = 0;
+    uint64_t hash = 0;
+    std::vector<Entry> entries;
+    std::unordered_map<GLuint, size_t> views; // view -> entry
+    double build_time_ms = 0.0;
+
+    void build(const std::filesystem::path& directory, cv::Mat& pixels);
+    bool load(const std::filesystem::path& cache_file, uint64_t expected_hash, cv::Mat& pixels);
+    bool save(const std::filesystem::path& cache_file, const cv::Mat& pixels) const;
+    void upload(const cv::Mat& pixels);
+};
@@ -3,11 +3,14 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 #include "app.hpp"
+#include "Maze.hpp"
+#include "MazeMesher.hpp"
 #include <iostream>
 #include <stdexcept>
 #include <fstream>
 #include <random>
 #include <algorithm>
+#include <glm/gtc/constants.hpp>
 
 // Vertex shader for the simple triangle
 const char* vertexShaderSource = R"(
@@ -36,6 +39,19 @@ void checkGLError(const std::string& context) {
     }
 }
 
+static const char* occlusionModeName(OcclusionMode mode) {
+    switch (mode) {
+    case OcclusionMode::Software: return "software";
+    case OcclusionMode::GpuHiZ: return "GPU Hi-Z";
+    case OcclusionMode::Queries: return "queries";
+    default: return "off";
+    }
+}
+
+static const char* renderPathName(RenderPath path) {
+    return path == RenderPath::Deferred ? "deferred" : "forward";
+}
+
 bool AABBintersect(const glm::vec3& minA, const glm::vec3& maxA,
     const glm::vec3& minB, const glm::vec3& maxB) {
     return (minA.x <= maxB.x && maxA.x >= minB.x) &&
@@ -56,6 +72,19 @@ App::App() : lastX(400.0), lastY(300.0), firstMouse(true), fov(DEFAULT_FOV), vsy
 
 App::~App() {
     shader.clear();
+    crowd.cleanup();
+    particleSystem.cleanup();
+    lights.cleanup();
+    shading_lights.cleanup();
+    clustered_lighting.cleanup();
+    deferred_renderer.cleanup();
+    instanced_renderer.cleanup();
+    geometry_arena.cleanup();
+    texture_arrays.cleanup();
+    texture_atlas.cleanup();
+    glDeleteQueries(SCENE_TIMER_FRAMES, scene_timers);
+    hiz_culler.cleanup();
+    occlusion_queries.cleanup();
     if (triangle) {
         delete triangle;
         triangle = nullptr;
@@ -72,16 +101,21 @@ App::~App() {
         delete model;
     }
     models.clear();
+    delete prop_model;
+    prop_model = nullptr;
 
-    glDeleteTextures(1, &myTexture);
-    glDeleteTextures(transparent_textures.size(), transparent_textures.data());
+    gl_state::deleteTextures(1, &myTexture);
+    gl_state::deleteTextures(1, &wall_texture);
+    gl_state::deleteTextures(transparent_textures.size(), transparent_textures.data());
     transparent_textures.clear();
-    glDeleteTextures(model_textures.size(), model_textures.data());
+    gl_state::deleteTextures(model_textures.size(), model_textures.data());
     model_textures.clear();
 
-    glDeleteVertexArrays(1, &VAO);
+    gl_state::deleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
-    glDeleteProgram(shaderProgram);
+    gl_state::deleteProgram(shaderProgram);
+    materials::cleanup();
+    gpu_memory::cleanup(); // mesh and per frame data of everything above
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -97,6 +131,12 @@ void App::init_glfw() {
     validate_antialiasing_settings(config, aa_enabled, aa_samples);
     antialiasing_enabled = aa_enabled; // Store in member variable
     samples = aa_samples;             // Store in member variable
+    if (config.contains("benchmark")) {
+        benchmark_mode = config["benchmark"].value("enabled", false);
+    }
+    if (config.contains("graphics")) {
+        allow_bindless = config["graphics"].value("bindless_textures", true);
+    }
 
     if (!glfwInit()) {
         throw std::runtime_error("GLFW can not be initialized.");
@@ -142,7 +182,7 @@ void App::init_glfw() {
     std::cout << "VSync initialized: " << (vsync ? "ON" : "OFF") << std::endl;
 
     if (antialiasing_enabled) {
-        glEnable(GL_MULTISAMPLE);
+        gl_state::enable(GL_MULTISAMPLE);
         std::cout << "Antialiasing enabled with " << samples << " samples" << std::endl;
     }
     else {
@@ -165,12 +205,12 @@ bool App::init() {
     glfwSetMouseButtonCallback(window, mouse_button_callback);
 
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
+    gl_state::enable(GL_DEPTH_TEST);
+    gl_state::depthFunc(GL_LEQUAL);
+    gl_state::enable(GL_BLEND);
+    gl_state::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state::enable(GL_CULL_FACE);
+    gl_state::cullFace(GL_BACK);
 
     glfwGetFramebufferSize(window, &width, &height);
     glViewport(0, 0, width, height);
@@ -184,17 +224,44 @@ bool App::init() {
 
     init_assets();
     init_triangle();
+    buildSceneBVH();
+    try {
+        // wall chunks only, the terrain covers the whole view and is drawn like any other object
+        std::vector<Model*> wall_chunks;
+        for (auto* wall : maze_walls) if (wall != terrain) wall_chunks.push_back(wall);
+        hiz_culler.init(wall_chunks, shader);
+    }
+    catch (const std::exception& e) {
+        // optional, the other occlusion modes still work
+        std::cerr << "HiZCuller init error: " << e.what() << std::endl;
+    }
+    try {
+        occlusion_queries.init();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "OcclusionQueries init error: " << e.what() << std::endl;
+    }
+    try {
+        deferred_renderer.init();
+    }
+    catch (const std::exception& e) {
+        // optional, forward shading still works
+        std::cerr << "DeferredRenderer init error: " << e.what() << std::endl;
+    }
+    glCreateQueries(GL_TIME_ELAPSED, SCENE_TIMER_FRAMES, scene_timers);
     update_projection_matrix();
 
-    if (shader.getID() != 0) {
-        shader.activate();
-        shader.setUniform("uV_m", camera.GetViewMatrix());
+    if (benchmark_mode) {
+        DistanceField::benchmark(4096);
     }
 
     return true;
 }
 
 void App::init_assets() {
+    // small textures come from one atlas, textureInit hands out views of it
+    texture_atlas.loadOrBuild("resources/textures", "resources/cache/textures.atlas");
+
     myTexture = textureInit("resources/textures/grass.png");
     if (myTexture == 0) {
         std::cerr << "Failed to load texture for ImGUI" << std::endl;
@@ -206,6 +273,15 @@ void App::init_assets() {
     try {
         std::cout << "Loading main shader..." << std::endl;
         shader = ShaderProgram("resources/shaders/tex.vert", "resources/shaders/tex.frag");
+        u_model = shader.uniform("uM_m");
+        u_tex0 = shader.uniform("tex0");
+        shader.setUniform(u_tex0, 0);
+        u_gbuffer_pass = shader.uniform("uGBufferPass");
+        u_per_object_lights = shader.uniform("uPerObjectLights");
+        u_object_light_count = shader.uniform("uObjectLightCount");
+        u_object_lights = shader.uniform("uObjectLights");
+        instanced_renderer.init(shader);
+        texture_arrays.init(shader); // sampler units of the arrays, must differ from tex0 before the first draw
         std::cout << "Main shaders loaded successfully" << std::endl;
     }
     catch (const std::exception& e) {
@@ -233,6 +309,15 @@ void App::init_assets() {
         std::cerr << "Terrain creation error: " << e.what() << std::endl;
         throw;
     }
+    try {
+        std::cout << "Creating crowd..." << std::endl;
+        createCrowd();
+        std::cout << "Crowd created successfully" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Crowd creation error: " << e.what() << std::endl;
+        throw;
+    }
     try {
         std::cout << "Creating models..." << std::endl;
         createModels();
@@ -252,11 +337,65 @@ void App::init_assets() {
         throw;
     }
 
-    
+
+    // walls, terrain and the opaque models share the arena buffers
+    geometry_arena.init(shader);
+    size_t arena_meshes = 0;
+    for (auto* model : maze_walls) for (auto& mesh : model->meshes) arena_meshes += geometry_arena.add(mesh);
+    for (auto* model : models) for (auto& mesh : model->meshes) arena_meshes += geometry_arena.add(mesh);
+    GpuAllocator::Stats vertex_stats = gpu_memory::vertices().getStats();
+    std::cout << "GeometryArena: " << arena_meshes << " meshes, vertex memory " << vertex_stats.used / (1024 * 1024)
+        << " MB in " << vertex_stats.pools << " pools" << std::endl;
+
+    // textures of all materials go into arrays (or bindless handles), no binds per draw,
+    // then every material record is built once and the draws only pass indices
+    std::vector<GLuint> textures;
+    for (auto& material : materials::all()) {
+        texture_atlas.apply(*material);
+        textures.push_back(material->texture_id);
+    }
+    texture_arrays.build(textures, allow_bindless);
+    for (auto& material : materials::all()) texture_arrays.apply(*material);
+    materials::upload();
+    std::cout << "Materials: " << materials::all().size() << std::endl;
 
     initLights();
 }
 
+void App::buildSceneBVH() {
+    scene_objects.clear();
+    scene_objects.insert(scene_objects.end(), maze_walls.begin(), maze_walls.end());
+    scene_objects.insert(scene_objects.end(), models.begin(), models.end());
+    scene_objects.insert(scene_objects.end(), transparent_objects.begin(), transparent_objects.end());
+
+    std::vector<AABB> bounds(scene_objects.size());
+    for (size_t i = 0; i < scene_objects.size(); ++i) {
+        scene_objects[i]->getWorldBounds(bounds[i].min, bounds[i].max);
+    }
+    scene_bvh.build(bounds);
+    std::cout << "Scene BVH: " << scene_objects.size() << " objects, " << scene_bvh.getNodeCount() << " nodes" << std::endl;
+}
+
+void App::updateSceneBVH() {
+    // only the models move (tractor, cube), walls and transparent objects are static
+    for (size_t i = 0; i < models.size(); ++i) {
+        AABB bounds;
+        models[i]->getWorldBounds(bounds.min, bounds.max);
+        scene_bvh.updateItem(static_cast<int>(maze_walls.size() + i), bounds);
+    }
+    scene_bvh.refit();
+}
+
+void App::pickObject() {
+    float distance = 0.0f;
+    int id = scene_bvh.raycast(camera.Position, camera.Front, 1000.0f, &distance);
+    if (id < 0) {
+        std::cout << "Picked: nothing" << std::endl;
+        return;
+    }
+    std::cout << "Picked: " << scene_objects[id]->name << " at distance " << distance << std::endl;
+}
+
 void App::initLights() {
     std::filesystem::path point_lights_path = "resources/lights/point_lights.lights";
     std::ifstream file_point_light(point_lights_path);
@@ -301,6 +440,121 @@ void App::initLights() {
     }
 }
 
+// Small colored point lights above random floor cells of the maze, to stress the clustered lighting
+void App::addRandomLights(int count) {
+    static std::mt19937 gen(7);
+    std::uniform_int_distribution<int> cell_x(0, maze_map.cols - 1);
+    std::uniform_int_distribution<int> cell_y(0, maze_map.rows - 1);
+    std::uniform_real_distribution<float> hue(0.0f, 6.0f);
+    for (int i = 0; i < count; ++i) {
+        int x, y;
+        do {
+            x = cell_x(gen);
+            y = cell_y(gen);
+        } while (maze::isWall(maze_map, x, y));
+        float h = hue(gen);
+        glm::vec3 color = glm::clamp(glm::vec3(std::abs(h - 3.0f) - 1.0f, 2.0f - std::abs(h - 2.0f), 2.0f - std::abs(h - 4.0f)), 0.0f, 1.0f);
+        lights.pointLights.emplace_back(maze::cellCenter(x, y, 0.4f * maze::WALL_HEIGHT), color * 0.05f, color, color,
+            1.0f, 0.35f, 0.44f);
+    }
+    std::cout << "Point lights: " << lights.pointLights.size() << std::endl;
+}
+
+// Crates on random floor cells of the maze, to stress the instanced drawing
+void App::addRandomProps(int count) {
+    if (!prop_model) {
+        return;
+    }
+    static std::mt19937 gen(11);
+    std::uniform_int_distribution<int> cell_x(0, maze_map.cols - 1);
+    std::uniform_int_distribution<int> cell_y(0, maze_map.rows - 1);
+    std::uniform_real_distribution<float> yaw(0.0f, glm::two_pi<float>());
+    std::uniform_real_distribution<float> size(0.4f, 0.9f);
+    for (int i = 0; i < count; ++i) {
+        int x, y;
+        do {
+            x = cell_x(gen);
+            y = cell_y(gen);
+        } while (maze::isWall(maze_map, x, y));
+        float s = size(gen);
+        glm::mat4 matrix = glm::translate(glm::mat4(1.0f), maze::cellCenter(x, y, 0.5f * s));
+        matrix = glm::rotate(matrix, yaw(gen), glm::vec3(0.0f, 1.0f, 0.0f));
+        matrix = glm::scale(matrix, glm::vec3(s));
+        prop_matrices.push_back(matrix);
+        // the rotated box stays inside the circumscribed one
+        glm::vec3 center(matrix[3]);
+        glm::vec3 extent(s * 0.5f * glm::root_two<float>(), s * 0.5f, s * 0.5f * glm::root_two<float>());
+        prop_bounds.emplace_back(center - extent, center + extent);
+    }
+    std::cout << "Props: " << prop_matrices.size() << std::endl;
+}
+
+// Uploads the most relevant lights of the model for the next draw (PerObject light culling only)
+void App::applyObjectLights(Model* model) {
+    if (light_culling != LightCulling::PerObject) {
+        return;
+    }
+    GLint object_lights[PerObjectLights::MAX_LIGHTS];
+    glm::vec3 bmin, bmax;
+    model->getWorldBounds(bmin, bmax);
+    int count = per_object_lights.assign(bmin, bmax, object_lights);
+    shader.setUniform(u_object_light_count, count);
+    shader.setUniform(u_object_lights, object_lights, count);
+}
+
+void App::beginSceneTimer() {
+    int slot = scene_timer_frame % SCENE_TIMER_FRAMES;
+    if (scene_timer_frame >= SCENE_TIMER_FRAMES) {
+        // ended SCENE_TIMER_FRAMES frames ago, normally available without waiting
+        GLuint available = 0;
+        glGetQueryObjectuiv(scene_timers[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(scene_timers[slot], GL_QUERY_RESULT, &elapsed);
+            scene_gpu_ms = elapsed / 1.0e6;
+            if (benchmark_mode) {
+                int path = static_cast<int>(scene_timer_paths[slot]);
+                benchmark_gpu_ms[path] += scene_gpu_ms;
+                benchmark_gpu_samples[path]++;
+            }
+        }
+    }
+    scene_timer_paths[slot] = render_path;
+    glBeginQuery(GL_TIME_ELAPSED, scene_timers[slot]);
+}
+
+void App::endSceneTimer() {
+    glEndQuery(GL_TIME_ELAPSED);
+    scene_timer_frame++;
+}
+
+// Runs BENCHMARK_PHASES phases alternating forward and deferred shading, then prints the averages
+void App::updateRenderBenchmark(float deltaTime) {
+    int phase = benchmark_frame / BENCHMARK_PHASE_FRAMES;
+    if (phase > BENCHMARK_PHASES) {
+        return;
+    }
+    if (benchmark_frame > 0) {
+        int path = static_cast<int>(render_path);
+        benchmark_frame_ms[path] += deltaTime * 1000.0;
+        benchmark_frame_samples[path]++;
+    }
+    if (phase == BENCHMARK_PHASES) {
+        std::cout << "Render path benchmark (" << lights.pointLights.size() + lights.spotLights.size() << " lights):" << std::endl;
+        for (RenderPath path : { RenderPath::Forward, RenderPath::Deferred }) {
+            int i = static_cast<int>(path);
+            std::cout << "  " << renderPathName(path) << ": scene "
+                << benchmark_gpu_ms[i] / std::max(1, benchmark_gpu_samples[i]) << " ms GPU, frame "
+                << benchmark_frame_ms[i] / std::max(1, benchmark_frame_samples[i]) << " ms" << std::endl;
+        }
+        render_path = RenderPath::Forward;
+        benchmark_frame++;
+        return;
+    }
+    render_path = phase % 2 == 0 ? RenderPath::Forward : RenderPath::Deferred;
+    benchmark_frame++;
+}
+
 void App::init_triangle() {
     GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
     GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
@@ -329,13 +583,13 @@ void App::init_triangle() {
 
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
+    gl_state::bindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    gl_state::bindVertexArray(0);
 }
 
 void App::createTransparentObjects() {
@@ -400,16 +654,16 @@ void App::createTransparentObjects() {
     for (int i = 0; i < 3; i++) {
         Model* model = new Model(modelPaths[i], shader);
         if (!model->meshes.empty() && i < objectTextures.size()) {
-            model->meshes[0].texture_id = objectTextures[i];
-            model->meshes[0].diffuse_material = colors[i];
+            model->meshes[0].material = materials::get(colors[i], objectTextures[i]);
         }
         else {
             std::cerr << "Warning: No texture assigned to model " << modelPaths[i] << std::endl;
             if (!model->meshes.empty()) {
-                model->meshes[0].diffuse_material = colors[i];
+                model->meshes[0].material = materials::get(colors[i]);
             }
         }
         model->transparent = true;
+        model->query_occlusion = true;
         model->origin = positions[i];
         model->scale = scales[i];
         
@@ -482,10 +736,11 @@ void App::createModels() {
             model->orientation = glm::vec3(glm::radians(270.0f), 0.0f, 0.0f);
         }
         if (!model->meshes.empty()) {
-            model->meshes[0].texture_id = model_textures[i];
-            model->meshes[0].diffuse_material = colors[i];
+            model->meshes[0].material = materials::get(colors[i], model_textures[i]);
         }
         model->transparent = false;
+        model->occluder = (i == 0); // the big cube hides what is behind it
+        model->query_occlusion = true;
         model->origin = positions[i];
         model->scale = scales[i];
         
@@ -493,9 +748,19 @@ void App::createModels() {
         std::cout << "Placed model " << i << " at position ("
             << positions[i].x << ", " << positions[i].y << ", " << positions[i].z << ")\n";
     }
+
+    // one crate shared by all props, copies are only matrices
+    delete prop_model;
+    prop_model = new Model("resources/models/cube_triangles_vnt.obj", shader);
+    if (!prop_model->meshes.empty() && !model_textures.empty()) {
+        prop_model->meshes[0].material = materials::get(glm::vec4(1.0f), model_textures[0]);
+    }
 }
 
 GLuint App::textureInit(const std::filesystem::path& filepath) {
+    if (GLuint view = texture_atlas.createView(filepath)) {
+        return view;
+    }
     cv::Mat image = cv::imread(filepath.string(), cv::IMREAD_UNCHANGED);
     if (image.empty()) {
         std::cerr << "Failed to load texture: " << filepath << std::endl;
@@ -532,8 +797,7 @@ void App::createTerrainModel() {
     GLuint terrainTexture = textureInit("resources/textures/grass.png");
     terrain = new Model("resources/models/plane_tri_vnt.obj", shader);
     if (!terrain->meshes.empty()) {
-        terrain->meshes[0].texture_id = terrainTexture;
-        terrain->meshes[0].diffuse_material = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+        terrain->meshes[0].material = materials::get(glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), terrainTexture);
     }
     terrain->origin = glm::vec3(0.0f, 0.0f, 0.0f);
     terrain->scale = glm::vec3(400.0f, 1.0f, 400.0f);
@@ -545,7 +809,36 @@ void App::createMazeModel() {
     createTerrainModel();
     const int width = 400;
     const int height = 400;
-    maze_map = cv::Mat(height, width, CV_8U, cv::Scalar('.'));
+    maze_map = cv::Mat(height, width, CV_8U, cv::Scalar(maze::FLOOR));
+    // outer wall around the whole maze
+    for (int i = 0; i < width; i++) {
+        maze_map.at<uchar>(0, i) = maze::WALL;
+        maze_map.at<uchar>(height - 1, i) = maze::WALL;
+    }
+    for (int i = 0; i < height; i++) {
+        maze_map.at<uchar>(i, 0) = maze::WALL;
+        maze_map.at<uchar>(i, width - 1) = maze::WALL;
+    }
+
+    wall_texture = textureInit("resources/textures/wall.png");
+    std::vector<Model*> wall_chunks = MazeMesher::buildChunks(maze_map, shader, wall_texture, 32, maze::WALL_HEIGHT);
+    maze_walls.insert(maze_walls.end(), wall_chunks.begin(), wall_chunks.end());
+
+    distance_field.build(maze_map);
+    std::cout << "Distance field " << width << "x" << height << " built in "
+        << distance_field.getBuildTimeMs() << " ms" << std::endl;
+
+    pvs.loadOrBuild(maze_map, "resources/cache/maze.pvs");
+}
+
+void App::createCrowd() {
+    ShaderProgram crowdShader("resources/shaders/crowd.vert", "resources/shaders/crowd.frag");
+    crowd.initialize(maze_map, crowdShader.getID());
+    crowd.addGoal(maze::cellCenter(maze_map.cols / 2, maze_map.rows / 2));
+    crowd.addGoal(maze::cellCenter(20, 20));
+    crowd.addGoal(maze::cellCenter(maze_map.cols - 20, maze_map.rows - 20));
+    crowd.buildFlowFields();
+    crowd.spawnAgents(2000);
 }
 
 uchar App::getmap(cv::Mat& map, int x, int y) {
@@ -561,15 +854,12 @@ bool App::run() {
     }
     if (fov <= 0.0f) fov = DEFAULT_FOV;
 
-    glEnable(GL_PROGRAM_POINT_SIZE); // nutné pro gl_PointSize
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state::enable(GL_PROGRAM_POINT_SIZE); // nutné pro gl_PointSize
+    gl_state::enable(GL_BLEND);
+    gl_state::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     shader.activate();
     update_projection_matrix();
-    shader.setUniform("uV_m", camera.GetViewMatrix());
-    shader.setUniform("uP_m", projection_matrix);
-    shader.setUniform("viewPos", camera.Position);
 
     double lastTime = glfwGetTime();
     double lastFrameTime = lastTime;
@@ -577,6 +867,8 @@ bool App::run() {
     std::string title = "PG2";
 
     while (!glfwWindowShouldClose(window)) {
+        gl_state::resetStats();
+        gpu_memory::stream().beginFrame(); // waits until the GPU is done with the region of FRAMES frames ago
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -593,6 +885,10 @@ bool App::run() {
             lastTime = currentTime;
         }
 
+        if (benchmark_mode) {
+            updateRenderBenchmark(deltaTime);
+        }
+
         shader.activate();
 
         // --- světla ---
@@ -645,6 +941,7 @@ bool App::run() {
             glm::vec3 emitterPos = glm::vec3(models[0]->getModelMatrix() * glm::vec4(0.0f, 0.5f, 0.0f, 1.0f));
             particleSystem.update(deltaTime, emitterPos, emitterPos.y);
         }
+        crowd.update(deltaTime);
 
         // traktor
         //if (models.size() > 2) {
@@ -652,8 +949,6 @@ bool App::run() {
             models[2]->origin = glm::vec3(75.0f, 40.0f, xPos);
         //}
 
-        lights.apply(shader.getID());
-
         // pohyb kamery
         glm::vec3 direction = camera.ProcessKeyboard(window, deltaTime);
         glm::vec3 newPos = camera.Position + direction * deltaTime;
@@ -668,70 +963,278 @@ bool App::run() {
         glm::vec3 cameraMin = newPos - glm::vec3(0.5f, 1.0f, 0.5f);
         glm::vec3 cameraMax = newPos + glm::vec3(0.5f, 1.0f, 0.5f);
 
+        // animate first, the BVH refit, the collision test and the culling below all use this frame's bounds
+        for (auto& model : models) model->update(deltaTime);
+
+        // only objects near the camera get the exact (per vertex) bounds test, walls are handled below
+        updateSceneBVH();
         bool collision = false;
-        for (auto* m : models)
-            if (AABBintersect(cameraMin, cameraMax, m->getMinBounds(), m->getMaxBounds())) collision = true;
-        for (auto* m : transparent_objects)
+        std::vector<int> nearby;
+        scene_bvh.queryRadius(newPos, 1.5f, nearby);
+        for (int id : nearby) {
+            if (id < static_cast<int>(maze_walls.size())) continue;
+            Model* m = scene_objects[id];
             if (AABBintersect(cameraMin, cameraMax, m->getMinBounds(), m->getMaxBounds())) collision = true;
+        }
+        // maze walls: distance to the nearest wall cell center minus half a tile is the distance to its face
+        if (!distance_field.empty() && distance_field.sample(newPos) < 0.5f + 0.5f * maze::TILE_SIZE) collision = true;
         if (!collision) camera.Position = newPos;
 
-        shader.setUniform("uV_m", camera.GetViewMatrix());
-        shader.setUniform("viewPos", camera.Position);
-
-        for (auto& model : models) model->update(deltaTime);
+        // camera of every program for the rest of the frame
+        frame_uniforms.update(camera.GetViewMatrix(), projection_matrix, camera.Position, static_cast<float>(currentTime), width, height);
+        // with the light tree enabled, distant groups of point lights are shaded as single virtual lights
+        Lights& active_lights = use_light_tree ? shading_lights : lights;
+        if (use_light_tree) {
+            light_tree.update(lights.pointLights);
+            shading_lights.sun = lights.sun;
+            shading_lights.ambientLight = lights.ambientLight;
+            shading_lights.spotLights = lights.spotLights;
+            shading_lights.pointLights.clear();
+            light_tree.selectCut(camera.Position, shading_lights.pointLights);
+        }
+        active_lights.upload();
+        clustered_lighting.update(active_lights, camera.GetViewMatrix(), projection_matrix, width, height);
+        bool per_object = light_culling == LightCulling::PerObject;
+        if (per_object) {
+            per_object_lights.update(active_lights);
+            per_object_lights.resetStats();
+        }
 
+        beginSceneTimer();
         glClearColor(0.3f, 0.3f, 0.4f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // terrain + neprůhledné modely
-        for (auto& wall : maze_walls) if (!wall->transparent) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, wall->meshes[0].texture_id);
-            shader.setUniform("tex0", 0);
-            shader.setUniform("uM_m", wall->getModelMatrix());
-            wall->draw();
-        }
-        for (auto& model : models) if (!model->transparent) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, model->meshes[0].texture_id);
-            shader.setUniform("tex0", 0);
-            shader.setUniform("uM_m", model->getModelMatrix());
-            model->draw();
+        // deferred: the opaque passes below fill the G-buffer instead of shading
+        bool deferred = render_path == RenderPath::Deferred && deferred_renderer.isReady();
+        if (deferred) {
+            deferred_renderer.beginGeometryPass(width, height);
         }
+        shader.setUniform(u_gbuffer_pass, deferred ? 1 : 0);
+        texture_arrays.bind();
+        shader.setUniform(u_per_object_lights, per_object ? 1 : 0);
+
+        // PVS: skip objects lying only in maze cells that can not be seen from the camera's cell
+        int camera_cell = pvs.cellAt(camera.Position);
+        auto pvsVisible = [&](const Model* m) {
+            glm::vec3 bmin, bmax;
+            m->getWorldBounds(bmin, bmax);
+            return pvs.isBoxVisible(camera_cell, bmin, bmax);
+        };
 
-        // vykresli particle efekt
-        particleSystem.render(projection_matrix, camera.GetViewMatrix());
-        shader.activate();
-        shader.setUniform("uV_m", camera.GetViewMatrix());
-        shader.setUniform("uP_m", projection_matrix);
-        shader.setUniform("viewPos", camera.Position);
-        // průhledné objekty
+        // BVH frustum query -> PVS -> exact SIMD frustum test, compacted draw lists
+        frustum_culler.setViewProjection(projection_matrix * camera.GetViewMatrix());
+        frustum_culler.resetStats();
+        std::vector<int> bvh_visible;
+        scene_bvh.queryFrustum(frustum_culler.getPlanes(), bvh_visible);
+        std::sort(bvh_visible.begin(), bvh_visible.end()); // keep walls, models, transparent objects order
+        size_t bvh_culled = scene_objects.size() - bvh_visible.size();
+        std::vector<Model*> candidates;
+        std::vector<Model*> transparent_candidates;
+        bool gpu_walls = occlusion_mode == OcclusionMode::GpuHiZ && hiz_culler.isReady();
+        size_t pvs_culled = 0;
+        size_t gpu_wall_count = 0;
+        for (int id : bvh_visible) {
+            if (gpu_walls && id < static_cast<int>(maze_walls.size()) && scene_objects[id] != terrain) {
+                gpu_wall_count++; // culled on the GPU
+                continue;
+            }
+            Model* m = scene_objects[id];
+            if (!pvsVisible(m)) {
+                pvs_culled++;
+                continue;
+            }
+            bool is_transparent = m->transparent || id >= static_cast<int>(maze_walls.size() + models.size());
+            (is_transparent ? transparent_candidates : candidates).push_back(m);
+        }
+        std::vector<Model*> opaque_draw_list;
+        frustum_culler.cull(candidates, opaque_draw_list);
+
+        // software occlusion: visible occluders are rasterized, then every draw is tested against them
+        software_occlusion.beginFrame(projection_matrix * camera.GetViewMatrix());
+        if (occlusion_mode == OcclusionMode::Software) {
+            for (auto* model : opaque_draw_list) if (model->occluder) software_occlusion.addOccluder(model);
+            software_occlusion.rasterize();
+            candidates.swap(opaque_draw_list);
+            opaque_draw_list.clear();
+            software_occlusion.cull(candidates, opaque_draw_list);
+        }
         std::vector<Model*> transparent_draw_list;
-        for (auto& wall : maze_walls) if (wall->transparent) transparent_draw_list.push_back(wall);
-        for (auto& obj : transparent_objects) transparent_draw_list.push_back(obj);
-        for (auto& model : models) if (model->transparent) transparent_draw_list.push_back(model);
-        std::sort(transparent_draw_list.begin(), transparent_draw_list.end(),
-            [this](Model* a, Model* b) {
-                return glm::distance(camera.Position, a->origin) > glm::distance(camera.Position, b->origin);
-            });
-        glDepthMask(GL_FALSE);
+        frustum_culler.cull(transparent_candidates, transparent_draw_list);
+        if (occlusion_mode == OcclusionMode::Software) {
+            transparent_candidates.swap(transparent_draw_list);
+            transparent_draw_list.clear();
+            software_occlusion.cull(transparent_candidates, transparent_draw_list);
+        }
+
+        if (gpu_walls) {
+            // the walls are one merged multi-draw, they always use the clustered lists
+            shader.setUniform(u_per_object_lights, 0);
+            hiz_culler.render(shader);
+            shader.setUniform(u_per_object_lights, per_object ? 1 : 0);
+        }
+
+        // occlusion queries: objects hidden last frame wait until the queries are issued
+        bool use_queries = occlusion_mode == OcclusionMode::Queries;
+        std::vector<Model*> query_objects;
+        std::vector<Model*> deferred_draw_list;
+        if (use_queries) {
+            occlusion_queries.beginFrame();
+            for (auto* model : opaque_draw_list) if (model->query_occlusion) query_objects.push_back(model);
+            for (auto* model : transparent_draw_list) if (model->query_occlusion) query_objects.push_back(model);
+        }
+
+        // terrain + neprůhledné modely, arena meshes are collected into multi-draws
+        // (per object light lists are per draw uniforms, those draws go one by one),
+        // the other draws and the transparent objects go through the sorted render queue
+        bool multi_draw = use_multi_draw && !per_object;
+        if (multi_draw) {
+            geometry_arena.begin();
+        }
+        render_queue.begin(camera.Position, camera.Front);
+        for (auto* model : opaque_draw_list) {
+            if (use_queries && !occlusion_queries.wasVisible(model)) {
+                deferred_draw_list.push_back(model);
+                continue;
+            }
+            if (multi_draw && geometry_arena.contains(*model)) {
+                geometry_arena.draw(*model, model->getModelMatrix());
+                continue;
+            }
+            render_queue.add(RenderQueue::Pass::Opaque, model);
+        }
         for (auto* model : transparent_draw_list) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, model->meshes[0].texture_id);
-            shader.setUniform("tex0", 0);
-            shader.setUniform("uM_m", model->getModelMatrix());
-            model->draw();
+            render_queue.add(RenderQueue::Pass::Transparent, model);
+        }
+        render_queue.sort();
+
+        auto drawModel = [&](Model* model) {
+            shader.setUniform(u_model, model->getModelMatrix());
+            applyObjectLights(model);
+            model->drawMeshes();
+        };
+        render_queue.submit(RenderQueue::Pass::Opaque, drawModel);
+        if (multi_draw) {
+            geometry_arena.submit(shader);
         }
-        glDepthMask(GL_TRUE);
+
+        // props: one instanced draw per mesh and material, lit by the clustered lists
+        if (!prop_matrices.empty()) {
+            instanced_renderer.begin();
+            for (size_t i = 0; i < prop_matrices.size(); ++i) {
+                const AABB& box = prop_bounds[i];
+                if (!frustum_culler.isBoxVisible(box.min, box.max) || !pvs.isBoxVisible(camera_cell, box.min, box.max)) continue;
+                instanced_renderer.add(*prop_model, prop_matrices[i]);
+            }
+            shader.setUniform(u_per_object_lights, 0);
+            instanced_renderer.draw(shader);
+            shader.setUniform(u_per_object_lights, per_object ? 1 : 0);
+        }
+
+        if (use_queries) {
+            occlusion_queries.issueQueries(query_objects, camera.Position);
+            shader.activate();
+            for (auto* model : deferred_draw_list) {
+                // drawn only if the box query issued above passed, decided on the GPU
+                GLuint query = occlusion_queries.getConditionQuery(model);
+                if (query) glBeginConditionalRender(query, GL_QUERY_NO_WAIT);
+                shader.setUniform(u_model, model->getModelMatrix());
+                applyObjectLights(model);
+                model->draw();
+                if (query) glEndConditionalRender();
+            }
+        }
+
+        if (deferred) {
+            shader.setUniform(u_gbuffer_pass, 0);
+            deferred_renderer.lightingPass();
+        }
+
+        // vykresli particle efekt
+        particleSystem.render();
+        crowd.render();
+        shader.activate();
+        // průhledné objekty, back to front from the queue keys
+        gl_state::enable(GL_BLEND);
+        gl_state::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        gl_state::depthMask(false);
+        render_queue.submit(RenderQueue::Pass::Transparent, [&](Model* model) {
+            GLuint query = use_queries ? occlusion_queries.getConditionQuery(model) : 0;
+            if (query) glBeginConditionalRender(query, GL_QUERY_NO_WAIT);
+            drawModel(model);
+            if (query) glEndConditionalRender();
+        });
+        gl_state::depthMask(true);
+        endSceneTimer();
         
         // ImGui
         if (show_imgui) {
             ImGui::SetNextWindowPos(ImVec2(10, 10));
-            ImGui::SetNextWindowSize(ImVec2(250, 120));
+            ImGui::SetNextWindowSize(ImVec2(250, 385));
             ImGui::Begin("Monitoring", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
             ImGui::Text("V-Sync: %s", vsync ? "ON" : "OFF");
             ImGui::Text("AA: %s, Samples: %d", antialiasing_enabled ? "ON" : "OFF", samples);
             ImGui::Text("FPS: %d", frameCount);
+            size_t total_objects = scene_objects.size();
+            ImGui::Text("Visible: %zu / %zu", frustum_culler.getVisible(), total_objects);
+            ImGui::Text("Culled: BVH %zu, PVS %zu, frustum %zu", bvh_culled, pvs_culled, frustum_culler.getCulled());
+            ImGui::Text("BVH nodes: %zu", scene_bvh.getNodeCount());
+            if (occlusion_mode == OcclusionMode::Queries) {
+                ImGui::Text("Occlusion: %s, hidden %zu, issued %zu", occlusionModeName(occlusion_mode),
+                    occlusion_queries.getOccluded(), occlusion_queries.getIssued());
+                ImGui::Text("Queries: %zu pending, %.1f frames, %.3f ms", occlusion_queries.getPending(),
+                    occlusion_queries.getAverageLatency(), occlusion_queries.getQueryWaitMs());
+            }
+            else if (occlusion_mode == OcclusionMode::GpuHiZ) {
+                ImGui::Text("Occlusion: %s, %zu walls, culled %u (+%u frustum)", occlusionModeName(occlusion_mode),
+                    gpu_wall_count, hiz_culler.getOcclusionCulled(), hiz_culler.getFrustumCulled());
+            }
+            else {
+                ImGui::Text("Occlusion: %s, culled %zu (%.2f ms)", occlusionModeName(occlusion_mode),
+                    software_occlusion.getCulled(), software_occlusion.getRasterTimeMs());
+            }
+            if (light_culling == LightCulling::PerObject) {
+                size_t objects = std::max<size_t>(1, per_object_lights.getObjects());
+                ImGui::Text("Lights: %zu, %.1f per object (%zu dropped)", lights.pointLights.size() + lights.spotLights.size(),
+                    static_cast<float>(per_object_lights.getAssigned()) / objects, per_object_lights.getDropped());
+            }
+            else {
+                ImGui::Text("Lights: %zu, max %u per cluster (%.2f ms)", lights.pointLights.size() + lights.spotLights.size(),
+                    clustered_lighting.getMaxLightsPerCluster(), clustered_lighting.getAssignTimeMs());
+            }
+            if (use_light_tree) {
+                ImGui::Text("Light tree: cut %zu / %zu nodes, err %.3g", light_tree.getCutSize(), light_tree.getNodeCount(),
+                    light_tree.getCutError());
+            }
+            if (use_multi_draw && light_culling != LightCulling::PerObject) {
+                ImGui::Text("Multi-draw: %zu draws in %zu calls", geometry_arena.getDrawCount(), geometry_arena.getMultiDrawCount());
+            }
+            {
+                GpuAllocator::Stats vertex_stats = gpu_memory::vertices().getStats();
+                GpuAllocator::Stats index_stats = gpu_memory::indices().getStats();
+                StreamBuffer::Stats stream_stats = gpu_memory::stream().getStats();
+                double used = static_cast<double>(vertex_stats.used + index_stats.used) / (1024 * 1024);
+                double capacity = static_cast<double>(vertex_stats.capacity + index_stats.capacity) / (1024 * 1024);
+                ImGui::Text("GPU buffers: %.1f / %.1f MB, %zu allocations", used, capacity,
+                    vertex_stats.allocations + index_stats.allocations);
+                ImGui::Text("Stream: %.2f / %.1f MB, %zu ranges, %zu waits", static_cast<double>(stream_stats.used) / (1024 * 1024),
+                    static_cast<double>(stream_stats.capacity) / (1024 * 1024), stream_stats.allocations, stream_stats.waits);
+            }
+            if (texture_arrays.isBindless()) {
+                ImGui::Text("Textures: %zu bindless", texture_arrays.getTextureCount());
+            }
+            else {
+                ImGui::Text("Textures: %zu in %zu arrays", texture_arrays.getTextureCount(), texture_arrays.getArrayCount());
+            }
+            ImGui::Text("Queue: %zu draws, %zu program / %zu material changes", render_queue.getDrawCount(),
+                render_queue.getProgramChanges(), render_queue.getMaterialChanges());
+            gl_state::Stats gl_stats = gl_state::getStats();
+            ImGui::Text("GL state: %zu issued, %zu elided", gl_stats.issued, gl_stats.elided);
+            ImGui::Text("Atlas: %zu images, %dx%d", texture_atlas.getImageCount(), texture_atlas.getSize(), texture_atlas.getSize());
+            if (!prop_matrices.empty()) {
+                ImGui::Text("Props: %zu drawn in %zu instanced draws", instanced_renderer.getInstanceCount(),
+                    instanced_renderer.getGroupCount());
+            }
+            ImGui::Text("Shading: %s, scene %.2f ms GPU", renderPathName(render_path), scene_gpu_ms);
             ImGui::Text("(press RMB to release mouse)");
             ImGui::Text("(press H to show/hide info)");
             ImGui::End();
@@ -739,6 +1242,7 @@ bool App::run() {
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        gpu_memory::stream().endFrame();
         
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -752,12 +1256,7 @@ void App::update_projection_matrix() {
     if (fov <= 0.0f) fov = DEFAULT_FOV;
 
     float ratio = static_cast<float>(width) / height;
-    projection_matrix = glm::perspective(glm::radians(fov), ratio, 0.1f, 20000.0f);
-
-    if (shader.getID() != 0) {
-        shader.activate();
-        shader.setUniform("uP_m", projection_matrix);
-    }
+    projection_matrix = glm::perspective(glm::radians(fov), ratio, 0.1f, 20000.0f); // reaches the shaders with the next frame
 }
 
 GLuint App::compileShader(GLenum type, const char* source) {
@@ -841,6 +1340,32 @@ void App::key_callback(GLFWwindow* window, int key, int scancode, int action, in
             app->b += 0.1f;
             if (app->b > 1.0f) app->b = 0.0f;
             break;
+        case GLFW_KEY_O:
+            app->occlusion_mode = static_cast<OcclusionMode>((static_cast<int>(app->occlusion_mode) + 1) % 4);
+            std::cout << "Occlusion culling: " << occlusionModeName(app->occlusion_mode) << std::endl;
+            break;
+        case GLFW_KEY_P:
+            app->render_path = app->render_path == RenderPath::Forward ? RenderPath::Deferred : RenderPath::Forward;
+            std::cout << "Render path: " << renderPathName(app->render_path) << std::endl;
+            break;
+        case GLFW_KEY_K:
+            app->light_culling = app->light_culling == LightCulling::Clustered ? LightCulling::PerObject : LightCulling::Clustered;
+            std::cout << "Light culling: " << (app->light_culling == LightCulling::PerObject ? "per object" : "clustered") << std::endl;
+            break;
+        case GLFW_KEY_M:
+            app->use_multi_draw = !app->use_multi_draw;
+            std::cout << "Multi-draw submission: " << (app->use_multi_draw ? "on" : "off") << std::endl;
+            break;
+        case GLFW_KEY_I:
+            app->addRandomProps(1024);
+            break;
+        case GLFW_KEY_J:
+            app->use_light_tree = !app->use_light_tree;
+            std::cout << "Light tree: " << (app->use_light_tree ? "on" : "off") << std::endl;
+            break;
+        case GLFW_KEY_L:
+            app->addRandomLights(256);
+            break;
         case GLFW_KEY_H:
             app->show_imgui = !app->show_imgui;
             if (app->show_imgui) {
@@ -860,6 +1385,9 @@ void App::mouse_button_callback(GLFWwindow* window, int button, int action, int
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
         app->firstMouse = true;
     }
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+        app->pickObject();
+    }
     if (button == GLFW_MOUSE_BUTTON_MIDDLE && action == GLFW_PRESS) {
         app->fov = app->DEFAULT_FOV;
         app->update_projection_matrix();
@@ -892,11 +1420,15 @@ void create_default_config() {
     };
     config["graphics"] = {
         {"vsync", true},
+        {"bindless_textures", true},
         {"antialiasing", {
             {"enabled", true},
             {"samples", 4}
         }}
     };
+    config["benchmark"] = {
+        {"enabled", false}
+    };
     std::ofstream file("config.json");
     if (!file.is_open()) {
         std::cerr << "Failed to create config file!" << std::endl;
@@ -930,6 +1462,7 @@ json load_config() {
         };
         default_config["graphics"] = {
             {"vsync", true},
+            {"bindless_textures", true},
             {"antialiasing", {
                 {"enabled", true},
                 {"samples", 4}
@@ -19,9 +19,37 @@
 #include "imgui_impl_opengl3.h"
 #include "Lights.hpp"
 #include "ParticleSystem.hpp"
+#include "DistanceField.hpp"
+#include "PotentiallyVisibleSet.hpp"
+#include "CrowdSystem.hpp"
+#include "FrustumCuller.hpp"
+#include "SceneBVH.hpp"
+#include "SoftwareOcclusion.hpp"
+#include "HiZCuller.hpp"
+#include "OcclusionQueries.hpp"
+#include "ClusteredLighting.hpp"
+#include "DeferredRenderer.hpp"
+#include "PerObjectLights.hpp"
+#include "LightTree.hpp"
+#include "InstancedRenderer.hpp"
+#include "GeometryArena.hpp"
+#include "TextureArrays.hpp"
+#include "TextureAtlas.hpp"
+#include "RenderQueue.hpp"
+#include "GLState.hpp"
+#include "FrameUniforms.hpp"
 
 using json = nlohmann::json;
 
+// Occlusion culling used for the draw lists, cycled with O
+enum class OcclusionMode { Off, Software, GpuHiZ, Queries };
+
+// Shading of the opaque objects, toggled with P (transparent objects are always forward shaded)
+enum class RenderPath { Forward, Deferred };
+
+// Which lights a forward shaded fragment loops over, toggled with K
+enum class LightCulling { Clustered, PerObject };
+
 class App {
 public:
     App();
@@ -34,6 +62,8 @@ public:
 private:
     GLFWwindow* window = nullptr;
     ShaderProgram shader;
+    // Per-frame and per-draw uniforms of the main shader, resolved once after linking
+    ShaderProgram::UniformHandle u_model, u_tex0;
     Model* triangle = nullptr;
     std::vector<Model*> maze_walls;
     std::vector<Model*> transparent_objects;
@@ -55,15 +85,68 @@ private:
     bool vsync = true;
     bool antialiasing_enabled = true; // New: Store MSAA enabled state
     int samples = 4;                 // New: Store MSAA sample count
+    bool benchmark_mode = false;     // Run startup benchmarks (config.json: benchmark.enabled)
     float r = 0.0f, g = 0.0f, b = 0.0f;
     Model* terrain;
     std::vector<Model*> models;
     std::vector<GLuint> model_textures;
     GLuint myTexture = 0;
+    GLuint wall_texture = 0;
     GLuint VAO = 0, VBO = 0;
     GLuint shaderProgram = 0;
     Lights lights;
     ParticleSystem particleSystem;
+    DistanceField distance_field;
+    PotentiallyVisibleSet pvs;
+    CrowdSystem crowd;
+    FrustumCuller frustum_culler;
+    SceneBVH scene_bvh;
+    std::vector<Model*> scene_objects; // BVH items: maze walls, then models, then transparent objects
+    SoftwareOcclusion software_occlusion;
+    HiZCuller hiz_culler;              // GPU culling and indirect drawing of the maze walls
+    OcclusionQueries occlusion_queries;
+    ClusteredLighting clustered_lighting; // per froxel light lists for tex.frag
+    DeferredRenderer deferred_renderer;
+    RenderPath render_path = RenderPath::Forward;
+    ShaderProgram::UniformHandle u_gbuffer_pass;
+    PerObjectLights per_object_lights;
+    LightCulling light_culling = LightCulling::Clustered;
+    ShaderProgram::UniformHandle u_per_object_lights, u_object_light_count, u_object_lights;
+    LightTree light_tree;      // point lights aggregated per frame into a cut, toggled with J
+    bool use_light_tree = false;
+    Lights shading_lights;     // lights with the point lights replaced by the cut
+    // Props (crates) placed with I, many copies of one model drawn with hardware instancing
+    InstancedRenderer instanced_renderer;
+    Model* prop_model = nullptr;
+    std::vector<glm::mat4> prop_matrices;
+    std::vector<AABB> prop_bounds;
+    // Static meshes in shared buffers, the opaque pass is submitted with multi-draws (toggled with M)
+    GeometryArena geometry_arena;
+    bool use_multi_draw = true;
+    // Textures in arrays bound once per frame, or bindless (graphics.bindless_textures in config.json)
+    TextureArrays texture_arrays;
+    bool allow_bindless = true;
+    TextureAtlas texture_atlas; // small textures of resources/textures, cached in resources/cache
+    // Sorted submission of the single draws (opaque front to back by state, transparent back to front)
+    RenderQueue render_queue;
+    FrameUniforms frame_uniforms; // Frame block of all programs
+
+    // GPU time of the scene passes, read back SCENE_TIMER_FRAMES frames later
+    static constexpr int SCENE_TIMER_FRAMES = 3;
+    GLuint scene_timers[SCENE_TIMER_FRAMES] = {};
+    RenderPath scene_timer_paths[SCENE_TIMER_FRAMES] = {};
+    int scene_timer_frame = 0;
+    double scene_gpu_ms = 0.0;
+
+    // Benchmark mode alternates the render paths and prints their average times
+    static constexpr int BENCHMARK_PHASE_FRAMES = 300;
+    static constexpr int BENCHMARK_PHASES = 4;
+    int benchmark_frame = 0;
+    double benchmark_gpu_ms[2] = {};
+    double benchmark_frame_ms[2] = {};
+    int benchmark_gpu_samples[2] = {};
+    int benchmark_frame_samples[2] = {};
+    OcclusionMode occlusion_mode = OcclusionMode::Software;
 
     void init_assets();
     void init_triangle();
@@ -71,7 +154,17 @@ private:
     void createMazeModel();
     void createModels();
     void createTransparentObjects();
+    void createCrowd();
     void initLights();
+    void addRandomLights(int count);
+    void addRandomProps(int count);
+    void applyObjectLights(Model* model);
+    void beginSceneTimer();
+    void endSceneTimer();
+    void updateRenderBenchmark(float deltaTime);
+    void buildSceneBVH();
+    void updateSceneBVH();
+    void pickObject();
     GLuint textureInit(const std::filesystem::path& filepath);
     GLuint gen_tex(cv::Mat& image);
     void update_projection_matrix();
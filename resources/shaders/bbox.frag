@@ -0,0 +1,6 @@
+#version 460 core
+// Color writes are disabled while the boxes are drawn, only the depth test matters
+
+void main()
+{
+}
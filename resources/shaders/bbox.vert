@@ -0,0 +1,21 @@
+#version 460 core
+// Bounding box of an object for occlusion queries, aPos is a corner of the unit cube
+layout(location = 0) in vec3 aPos;
+
+// FrameUniforms: camera and frame constants, written once per frame
+layout(std140, binding = 0) uniform Frame {
+    mat4 uV_m;
+    mat4 uP_m;
+    mat4 uViewProj;
+    mat4 uInvViewProj;
+    vec3 viewPos;
+    float uTime;
+    vec4 uViewport; // width, height, 1 / width, 1 / height
+};
+uniform vec3 uMin;
+uniform vec3 uMax;
+
+void main()
+{
+    gl_Position = uViewProj * vec4(mix(uMin, uMax, aPos), 1.0);
+}
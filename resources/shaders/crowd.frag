@@ -0,0 +1,12 @@
+#version 460 core
+in vec3 vNormal;
+flat in int vGoal;
+out vec4 FragColor;
+
+const vec3 goalColors[4] = vec3[](vec3(0.9, 0.3, 0.2), vec3(0.2, 0.6, 0.9), vec3(0.3, 0.8, 0.3), vec3(0.9, 0.8, 0.2));
+
+void main() {
+    vec3 lightDir = normalize(vec3(0.5, 1.0, 0.3));
+    float diff = max(dot(normalize(vNormal), lightDir), 0.0);
+    FragColor = vec4(goalColors[vGoal % 4] * (0.35 + 0.65 * diff), 1.0);
+}
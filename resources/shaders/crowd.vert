@@ -0,0 +1,30 @@
+#version 460 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNorm;
+layout(location = 2) in vec4 aInstance; // x, z, heading, goal
+
+// FrameUniforms: camera and frame constants, written once per frame
+layout(std140, binding = 0) uniform Frame {
+    mat4 uV_m;
+    mat4 uP_m;
+    mat4 uViewProj;
+    mat4 uInvViewProj;
+    vec3 viewPos;
+    float uTime;
+    vec4 uViewport; // width, height, 1 / width, 1 / height
+};
+
+out vec3 vNormal;
+flat out int vGoal;
+
+void main() {
+    float c = cos(aInstance.z);
+    float s = sin(aInstance.z);
+    mat3 rot = mat3(c, 0.0, -s,
+                    0.0, 1.0, 0.0,
+                    s, 0.0, c);
+    vec3 worldPos = rot * aPos + vec3(aInstance.x, 0.0, aInstance.y);
+    vNormal = rot * aNorm;
+    vGoal = int(aInstance.w);
+    gl_Position = uViewProj * vec4(worldPos, 1.0);
+}
@@ -0,0 +1,195 @@
+#version 460 core
+
+// Layouts must match the Gpu* structs in Lights.hpp
+struct DirectionalLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+    float radius; // contribution fades out to zero at this distance
+};
+
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+    float radius;
+    float padding0;
+    float padding1;
+    float padding2;
+};
+
+layout(std140, binding = 1) uniform LightHeader {
+    DirectionalLight sun;
+    vec3 ambientColor;
+    int numPointLights;
+    int numSpotLights;
+};
+
+layout(std430, binding = 2) readonly buffer PointLights {
+    PointLight pointLights[];
+};
+
+layout(std430, binding = 3) readonly buffer SpotLights {
+    SpotLight spotLights[];
+};
+
+// Froxel grid of ClusteredLighting
+struct Cluster {
+    uint offset;     // first index in lightIndices
+    uint pointCount; // point light indices come first,
+    uint spotCount;  // then the spot light indices
+    uint padding;
+};
+
+layout(std140, binding = 4) uniform ClusterGrid {
+    uvec4 clusterSize;   // x, y, z
+    vec4 clusterParams;  // tile size in pixels, depth slice scale and bias
+};
+
+layout(std430, binding = 5) readonly buffer Clusters {
+    Cluster clusters[];
+};
+
+layout(std430, binding = 6) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+// Lighting pass of DeferredRenderer: shades every pixel of the G-buffer once
+in vec2 uv;
+
+layout(location = 0) out vec4 FragColor;
+
+layout(binding = 0) uniform sampler2D gAlbedo;
+layout(binding = 1) uniform sampler2D gNormal;
+layout(binding = 2) uniform sampler2D gDepth;
+
+// FrameUniforms: camera and frame constants, written once per frame
+layout(std140, binding = 0) uniform Frame {
+    mat4 uV_m;
+    mat4 uP_m;
+    mat4 uViewProj;
+    mat4 uInvViewProj;
+    vec3 viewPos;
+    float uTime;
+    vec4 uViewport; // width, height, 1 / width, 1 / height
+};
+
+vec3 CalcDirLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 texColor);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 texColor);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 texColor);
+float RangeWindow(float distance, float radius);
+
+void main()
+{
+    float sampledDepth = texture(gDepth, uv).r;
+    if (sampledDepth >= 1.0)
+        discard; // nothing was drawn here
+
+    // world position from the depth
+    vec4 clip = vec4(uv * 2.0 - 1.0, sampledDepth * 2.0 - 1.0, 1.0);
+    vec4 world = uInvViewProj * clip;
+    vec3 fragPos = world.xyz / world.w;
+
+    vec4 albedo = texture(gAlbedo, uv);
+    vec3 texColor = albedo.rgb;
+    vec3 norm = normalize(texture(gNormal, uv).xyz * 2.0 - 1.0);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 result = ambientColor * texColor;
+
+    result += CalcDirLight(sun, norm, viewDir, texColor);
+
+    float depth = -(uV_m * vec4(fragPos, 1.0)).z;
+    uvec3 cell;
+    cell.xy = min(uvec2(gl_FragCoord.xy / clusterParams.xy), clusterSize.xy - 1u);
+    cell.z = min(uint(max(log(depth) * clusterParams.z + clusterParams.w, 0.0)), clusterSize.z - 1u);
+    Cluster cluster = clusters[(cell.z * clusterSize.y + cell.y) * clusterSize.x + cell.x];
+
+    uint index = cluster.offset;
+    for(uint i = 0u; i < cluster.pointCount; ++i)
+        result += CalcPointLight(pointLights[lightIndices[index++]], norm, fragPos, viewDir, texColor);
+
+    for(uint i = 0u; i < cluster.spotCount; ++i)
+        result += CalcSpotLight(spotLights[lightIndices[index++]], norm, fragPos, viewDir, texColor);
+
+    FragColor = vec4(result, albedo.a);
+    gl_FragDepth = sampledDepth;
+}
+
+// Same lighting as tex.frag
+vec3 CalcDirLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 texColor)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+    vec3 ambient = light.ambient * texColor;
+    vec3 diffuse = light.diffuse * diff * texColor;
+    vec3 specular = light.specular * spec * texColor;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 texColor)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+    float distance = length(light.position - fragPos);
+    float attenuation = RangeWindow(distance, light.radius) / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    vec3 ambient = light.ambient * texColor;
+    vec3 diffuse = light.diffuse * diff * texColor;
+    vec3 specular = light.specular * spec * texColor;
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 texColor)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+    float distance = length(light.position - fragPos);
+    float attenuation = RangeWindow(distance, light.radius) / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    vec3 ambient = light.ambient * texColor;
+    vec3 diffuse = light.diffuse * diff * texColor;
+    vec3 specular = light.specular * spec * texColor;
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    return (ambient + diffuse + specular);
+}
+
+// Smooth falloff to zero at the light radius, so lights left out of a cluster contribute nothing there.
+// A light without range (radius 0) lights nothing instead of producing 0 / 0 at its position.
+float RangeWindow(float distance, float radius)
+{
+    float x = distance / max(radius, 1e-4);
+    x *= x;
+    float w = clamp(1.0 - x * x, 0.0, 1.0);
+    return w * w;
+}
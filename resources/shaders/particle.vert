@@ -2,14 +2,21 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in float aLife;
 
-uniform mat4 uP_m = mat4(1.0);
-uniform mat4 uV_m = mat4(1.0);
-uniform mat4 uM_m = mat4(1.0);
+// FrameUniforms: camera and frame constants, written once per frame
+layout(std140, binding = 0) uniform Frame {
+    mat4 uV_m;
+    mat4 uP_m;
+    mat4 uViewProj;
+    mat4 uInvViewProj;
+    vec3 viewPos;
+    float uTime;
+    vec4 uViewport; // width, height, 1 / width, 1 / height
+};
 
 out float vLife;
 
 void main() {
-    gl_Position = uP_m * uV_m * uM_m * vec4(aPos, 1.0);
+    gl_Position = uViewProj * vec4(aPos, 1.0);
     gl_PointSize = 5.0;
     vLife = aLife;
 }
@@ -1,12 +1,7 @@
 #version 460 core
+#extension GL_ARB_bindless_texture : enable
 
-#define MAX_POINT_LIGHTS 15
-#define MAX_SPOT_LIGHTS 15
-
-struct AmbientLight {
-    vec3 color;
-};
-
+// Layouts must match the Gpu* structs in Lights.hpp
 struct DirectionalLight {
     vec3 direction;
     vec3 ambient;
@@ -16,70 +11,159 @@ struct DirectionalLight {
 
 struct PointLight {
     vec3 position;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
+    float radius; // contribution fades out to zero at this distance
 };
 
 struct SpotLight {
     vec3 position;
+    float constant;
     vec3 direction;
-    float cutOff;
-    float outerCutOff;
+    float linear;
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
+    float cutOff;
     vec3 specular;
-    float constant;
-    float linear;
-    float quadratic;
+    float outerCutOff;
+    float radius;
+    float padding0;
+    float padding1;
+    float padding2;
+};
+
+layout(std140, binding = 1) uniform LightHeader {
+    DirectionalLight sun;
+    vec3 ambientColor;
+    int numPointLights;
+    int numSpotLights;
+};
+
+layout(std430, binding = 2) readonly buffer PointLights {
+    PointLight pointLights[];
+};
+
+layout(std430, binding = 3) readonly buffer SpotLights {
+    SpotLight spotLights[];
+};
+
+// Froxel grid of ClusteredLighting
+struct Cluster {
+    uint offset;     // first index in lightIndices
+    uint pointCount; // point light indices come first,
+    uint spotCount;  // then the spot light indices
+    uint padding;
+};
+
+layout(std140, binding = 4) uniform ClusterGrid {
+    uvec4 clusterSize;   // x, y, z
+    vec4 clusterParams;  // tile size in pixels, depth slice scale and bias
+};
+
+layout(std430, binding = 5) readonly buffer Clusters {
+    Cluster clusters[];
+};
+
+layout(std430, binding = 6) readonly buffer LightIndices {
+    uint lightIndices[];
 };
 
 in VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 texcoord;
+    flat vec4 diffuseColor; // material color including alpha
+    flat int textureArray;
+    flat int textureLayer;
+    flat uvec2 textureHandle;
+    flat vec4 textureRect;
 } fs_in;
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 GNormal; // G-buffer pass only
 
-uniform sampler2D tex0;
-uniform vec3 viewPos;
-uniform vec4 u_diffuse_color; // Material color including alpha
+uniform bool uGBufferPass; // DeferredRenderer geometry pass: store albedo and normal, no lighting
+
+// PerObjectLights: short light list of the draw instead of the froxel lists
+#define MAX_OBJECT_LIGHTS 8
+uniform bool uPerObjectLights;
+uniform int uObjectLightCount;
+uniform int uObjectLights[MAX_OBJECT_LIGHTS]; // point light i as i, spot light i as -(i + 1)
 
-uniform AmbientLight ambientLight;
-uniform DirectionalLight dirLights[1];
-uniform int numPointLights;
-uniform PointLight pointLights[MAX_POINT_LIGHTS];
-uniform int numSpotLights;
-uniform SpotLight spotLights[MAX_SPOT_LIGHTS];
+uniform sampler2D tex0;
+// TextureArrays: a bindless handle, else a layer of one of the bound arrays, else tex0.
+// The array index and the handle are dynamically uniform, as ARB_bindless_texture requires without
+// NV_gpu_shader5: multi-draws are batched per array and per handle.
+#define MAX_TEXTURE_ARRAYS 8
+uniform sampler2DArray uTextureArrays[MAX_TEXTURE_ARRAYS];
+// FrameUniforms: camera and frame constants, written once per frame
+layout(std140, binding = 0) uniform Frame {
+    mat4 uV_m;
+    mat4 uP_m;
+    mat4 uViewProj;
+    mat4 uInvViewProj;
+    vec3 viewPos;
+    float uTime;
+    vec4 uViewport; // width, height, 1 / width, 1 / height
+};
 
 vec3 CalcDirLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 texColor);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 texColor);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 texColor);
+float RangeWindow(float distance, float radius);
+vec4 SampleTexture(vec2 uv);
 
 void main()
 {
     vec3 norm = normalize(fs_in.Normal);
     vec3 viewDir = normalize(viewPos - fs_in.FragPos);
-    vec4 texSample = texture(tex0, fs_in.texcoord);
+    vec4 texSample = SampleTexture(fs_in.texcoord);
     vec3 texColor = texSample.rgb;
     float texAlpha = texSample.a;
 
     // Combine texture alpha with material alpha
-    float alpha = texAlpha * u_diffuse_color.a;
-
-    vec3 result = ambientLight.color * texColor;
-
-    result += CalcDirLight(dirLights[0], norm, viewDir, texColor);
-
-    for(int i = 0; i < numPointLights; ++i)
-        result += CalcPointLight(pointLights[i], norm, fs_in.FragPos, viewDir, texColor);
-
-    for(int i = 0; i < numSpotLights; ++i)
-        result += CalcSpotLight(spotLights[i], norm, fs_in.FragPos, viewDir, texColor);
+    float alpha = texAlpha * fs_in.diffuseColor.a;
+
+    if (uGBufferPass) {
+        FragColor = vec4(texColor, alpha);
+        GNormal = vec4(norm * 0.5 + 0.5, 1.0);
+        return;
+    }
+
+    vec3 result = ambientColor * texColor;
+
+    result += CalcDirLight(sun, norm, viewDir, texColor);
+
+    if (uPerObjectLights) {
+        for(int i = 0; i < uObjectLightCount; ++i) {
+            int light = uObjectLights[i];
+            if (light >= 0)
+                result += CalcPointLight(pointLights[light], norm, fs_in.FragPos, viewDir, texColor);
+            else
+                result += CalcSpotLight(spotLights[-light - 1], norm, fs_in.FragPos, viewDir, texColor);
+        }
+        FragColor = vec4(result, alpha);
+        return;
+    }
+
+    // only the lights assigned to the froxel of this fragment
+    float depth = -(uV_m * vec4(fs_in.FragPos, 1.0)).z;
+    uvec3 cell;
+    cell.xy = min(uvec2(gl_FragCoord.xy / clusterParams.xy), clusterSize.xy - 1u);
+    cell.z = min(uint(max(log(depth) * clusterParams.z + clusterParams.w, 0.0)), clusterSize.z - 1u);
+    Cluster cluster = clusters[(cell.z * clusterSize.y + cell.y) * clusterSize.x + cell.x];
+
+    uint index = cluster.offset;
+    for(uint i = 0u; i < cluster.pointCount; ++i)
+        result += CalcPointLight(pointLights[lightIndices[index++]], norm, fs_in.FragPos, viewDir, texColor);
+
+    for(uint i = 0u; i < cluster.spotCount; ++i)
+        result += CalcSpotLight(spotLights[lightIndices[index++]], norm, fs_in.FragPos, viewDir, texColor);
 
     FragColor = vec4(result, alpha);
 }
@@ -104,7 +188,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
     float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float attenuation = RangeWindow(distance, light.radius) / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     vec3 ambient = light.ambient * texColor;
     vec3 diffuse = light.diffuse * diff * texColor;
     vec3 specular = light.specular * spec * texColor;
@@ -121,7 +205,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
     float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float attenuation = RangeWindow(distance, light.radius) / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     float theta = dot(lightDir, normalize(-light.direction));
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
@@ -132,4 +216,35 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
     return (ambient + diffuse + specular);
-}
\ No newline at end of file
+}
+
+// Smooth falloff to zero at the light radius, so lights left out of a cluster contribute nothing there.
+// A light without range (radius 0) lights nothing instead of producing 0 / 0 at its position.
+float RangeWindow(float distance, float radius)
+{
+    float x = distance / max(radius, 1e-4);
+    x *= x;
+    float w = clamp(1.0 - x * x, 0.0, 1.0);
+    return w * w;
+}
+
+vec4 SampleTexture(vec2 uv)
+{
+    // atlas images repeat inside their rectangle, the mip level comes from the unwrapped coordinates
+    vec2 dx = dFdx(uv);
+    vec2 dy = dFdy(uv);
+    if (fs_in.textureRect.z > 0.0) {
+        uv = fs_in.textureRect.xy + fract(uv) * fs_in.textureRect.zw;
+        dx *= fs_in.textureRect.zw;
+        dy *= fs_in.textureRect.zw;
+    }
+#ifdef GL_ARB_bindless_texture
+    if (fs_in.textureHandle != uvec2(0)) {
+        return textureGrad(sampler2D(fs_in.textureHandle), uv, dx, dy);
+    }
+#endif
+    if (fs_in.textureArray >= 0) {
+        return textureGrad(uTextureArrays[fs_in.textureArray], vec3(uv, fs_in.textureLayer), dx, dy);
+    }
+    return textureGrad(tex0, uv, dx, dy);
+}
@@ -4,21 +4,78 @@ layout(location = 0) in vec3 aPos;
 layout(location = 2) in vec3 aNorm;
 layout(location = 1) in vec2 aTex;
 
-uniform mat4 uP_m;
-uniform mat4 uV_m;
+// FrameUniforms: camera and frame constants, written once per frame
+layout(std140, binding = 0) uniform Frame {
+    mat4 uV_m;
+    mat4 uP_m;
+    mat4 uViewProj;
+    mat4 uInvViewProj;
+    vec3 viewPos;
+    float uTime;
+    vec4 uViewport; // width, height, 1 / width, 1 / height
+};
 uniform mat4 uM_m;
 
+// Material library (materials::upload), prebuilt parameters of every material
+struct Material {
+    vec4 ambient;
+    vec4 diffuse; // color including alpha
+    vec4 specular; // w: reflectivity
+    uvec2 texture_handle; // TextureArrays: texture source of the draw, see tex.frag
+    int texture_array;
+    int texture_layer;
+    vec4 texture_rect; // TextureAtlas: image rectangle (offset, size), zero size outside of the atlas
+};
+layout(std430, binding = 8) readonly buffer Materials {
+    Material materials[];
+};
+uniform int uMaterial;
+
+// InstancedRenderer and GeometryArena: record per instance / per draw instead of uM_m and uMaterial
+struct Instance {
+    mat4 model;
+    mat3 normal; // std430: three vec4 columns
+    uint material;
+};
+layout(std430, binding = 7) readonly buffer Instances {
+    Instance instances[];
+};
+uniform bool uInstanced;
+
 out VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 texcoord;
+    flat vec4 diffuseColor;
+    flat int textureArray;
+    flat int textureLayer;
+    flat uvec2 textureHandle;
+    flat vec4 textureRect;
 } vs_out;
 
 void main()
 {
-    vec4 worldPos = uM_m * vec4(aPos, 1.0);
+    mat4 model = uM_m;
+    mat3 normalMatrix;
+    uint materialIndex = uint(uMaterial);
+    if (uInstanced) {
+        Instance instance = instances[gl_BaseInstance + gl_InstanceID];
+        model = instance.model;
+        normalMatrix = instance.normal;
+        materialIndex = instance.material;
+    }
+    else {
+        normalMatrix = mat3(transpose(inverse(uM_m)));
+    }
+    Material material = materials[materialIndex];
+    vs_out.diffuseColor = material.diffuse;
+    vs_out.textureArray = material.texture_array;
+    vs_out.textureLayer = material.texture_layer;
+    vs_out.textureHandle = material.texture_handle;
+    vs_out.textureRect = material.texture_rect;
+    vec4 worldPos = model * vec4(aPos, 1.0);
     vs_out.FragPos = worldPos.xyz;
-    vs_out.Normal = mat3(transpose(inverse(uM_m))) * aNorm;
+    vs_out.Normal = normalMatrix * aNorm;
     vs_out.texcoord = aTex;
-    gl_Position = uP_m * uV_m * worldPos;
+    gl_Position = uViewProj * worldPos;
 }
\ No newline at end of file